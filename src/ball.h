@@ -3,6 +3,7 @@
 #ifndef _BALL_H_
 #define _BALL_H_
 
+#include "codec.h"
 #include "internal.h"
 
 //! BALL COLORS
@@ -37,17 +38,31 @@ public:
 
 public:
 
-  //! size of binary serialization
-  static const size_t bytesize = 2*sizeof(name_t)+sizeof(color_t);
+  //! size of binary serialization.
+  //! the color is packed into the low bits of the name.
+  size_t bytesize (void) const {
+    return varint_size((uniq << 2) | color) + varint_size(_deme);
+  };
   //! binary serialization
   friend raw_t* operator>> (const ball_t &b, raw_t *o) {
-    name_t buf[2] = {b.uniq, b._deme};
-    memcpy(o,buf,sizeof(buf)); o += sizeof(buf);
-    memcpy(o,&b.color,sizeof(color_t)); o += sizeof(color_t);
-    return o;
+    o = put_varint(o,(b.uniq << 2) | b.color);
+    return put_varint(o,b._deme);
   };
   //! binary deserialization
   friend raw_t* operator>> (raw_t *o, ball_t &b) {
+    name_t u;
+    o = get_varint(o,u);
+    o = get_varint(o,b._deme);
+    b.uniq = u >> 2;
+    b.color = color_t(u & 3);
+    if (b.color > black)
+      err("in %s: corrupted genealogy serialization.",__func__); // #nocov
+    b._holder = 0;              // must be set elsewhere
+    b._owner = 0;               // must be set elsewhere
+    return o;
+  };
+  //! legacy (fixed-width) binary deserialization
+  friend raw_t* legacy (raw_t *o, ball_t &b) {
     name_t buf[2];
     memcpy(buf,o,sizeof(buf)); o += sizeof(buf);
     b.uniq = buf[0]; b._deme = buf[1];
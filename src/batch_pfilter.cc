@@ -0,0 +1,372 @@
+// Particle filters in which the filter equation is integrated
+// for blocks of particles at once.
+//
+// The particles' states are held as structures of arrays.
+// Within an interval between nodes, the event rates, waiting times,
+// event choices, and state updates of the BLOCK particles of a block
+// are computed in SIMD loops.  Particles whose next event falls beyond
+// the end of the interval are masked out until all in the block are done.
+// The random draws themselves are scalar,
+// since R's generator is a single sequential stream.
+// The filter equations are those of 'lbdp_gill' and 'sirs_gill',
+// with tau = 0 (i.e., exact).
+
+#include "genealogy.h"
+#include "cache.h"
+#include "internal.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <vector>
+
+//! number of particles in a block
+#define BLOCK 8
+
+//! The linear birth-death-sampling process (cf. lbdp_pomp.c).
+//! Parameters are (lambda, mu, psi, chi, n0); the state is n.
+class lbdp_block_t {
+
+public:
+
+  static const int nvar = 1;
+  static const int nrate = 2;
+  //! the change in the state due to each event: birth, death
+  static constexpr double jump[nrate][nvar] = {{1}, {-1}};
+
+private:
+
+  double lambda, mu, psi, chi, n0;
+
+public:
+
+  lbdp_block_t (const double *p)
+    : lambda(p[0]), mu(p[1]), psi(p[2]), chi(p[3]), n0(p[4]) {};
+
+  //! latent-state initializer (cf. lbdp_rinit)
+  void rinit (double *const x[], size_t j) const {
+    x[0][j] = nearbyint(n0);
+  };
+
+  //! singular portion of the filter equation at a node of the given
+  //! type and saturation, ell being the number of lineages after it.
+  //! returns the log weight.
+  double node (double *const x[], size_t j, int type, int sat, double ell) const {
+    double &n = x[0][j];
+    double ll = 0;
+    switch (type) {
+    default:                    // root
+      break;
+    case 1:                     // sample
+      if (sat == 1) {
+        ll += log(psi);
+      } else {
+        double drate = chi*n;
+        double trate = drate+psi*(n-ell);
+        ll += (trate > 0) ? log(trate) : R_NegInf;
+        if (trate > 0 && unif_rand() < drate/trate) n -= 1;
+      }
+      break;
+    case 2:                     // branch point
+      n += 1;
+      ll += log(2*lambda/n);
+      break;
+    }
+    return ll;
+  };
+
+  //! event rates, penalty, and total event rate of a block
+  void rates
+  (double *const x[], double ell,
+   double rate[][BLOCK], double *pen, double *tot) const {
+#pragma omp simd
+    for (int j = 0; j < BLOCK; j++) {
+      double n = x[0][j];
+      // 1 if n > ell, else 0; and the reverse
+      double free = std::min(std::max(n-ell,0.0),1.0);
+      double busy = std::min(std::max(ell+1-n,0.0),1.0);
+      // birth with saturation 0 or 1
+      // (if n = 0, then alpha = 0, so disc is immaterial)
+      double alpha = lambda*n;
+      double disc = ell*(ell-1)/std::max(n*(n+1),2.0);
+      rate[0][j] = alpha*(1-disc);
+      pen[j] = alpha*disc;
+      // death
+      alpha = mu*n;
+      rate[1][j] = free*alpha;
+      pen[j] += busy*alpha;
+      // sampling
+      pen[j] += (psi+chi)*n;
+      tot[j] = rate[0][j]+rate[1][j];
+    }
+  };
+
+};
+
+//! The SIRS model (cf. sirs_pomp.c).
+//! Parameters are (Beta, gamma, psi, chi, omega, S0, I0, R0, pop);
+//! the state is (S, I, R).
+class sirs_block_t {
+
+public:
+
+  static const int nvar = 3;
+  static const int nrate = 3;
+  //! the change in the state due to each event:
+  //! transmission, recovery, loss of immunity
+  static constexpr double jump[nrate][nvar] = {
+    {-1, 1, 0}, {0, -1, 1}, {1, 0, -1}
+  };
+
+private:
+
+  double Beta, gamma, psi, chi, omega, S0, I0, R0, pop;
+
+public:
+
+  sirs_block_t (const double *p)
+    : Beta(p[0]), gamma(p[1]), psi(p[2]), chi(p[3]), omega(p[4]),
+      S0(p[5]), I0(p[6]), R0(p[7]), pop(p[8]) {};
+
+  //! latent-state initializer (cf. sirs_rinit)
+  void rinit (double *const x[], size_t j) const {
+    double m = pop/(S0+I0+R0);
+    x[0][j] = nearbyint(S0*m);
+    x[1][j] = nearbyint(I0*m);
+    x[2][j] = nearbyint(R0*m);
+  };
+
+  //! singular portion of the filter equation at a node of the given
+  //! type and saturation, ell being the number of lineages after it.
+  //! returns the log weight.
+  double node (double *const x[], size_t j, int type, int sat, double ell) const {
+    double &S = x[0][j], &I = x[1][j];
+    double ll = 0;
+    switch (type) {
+    default:                    // root
+      break;
+    case 1:                     // sample
+      if (sat == 1) {
+        ll += log(psi);
+      } else {
+        ll += log(psi+chi);
+        if (psi+chi <= 0)
+          ll += R_NegInf;
+        else if (unif_rand() < psi/(psi+chi)) { // non-destructive sample
+          ll += log(I-ell);
+        } else {                // destructive sample
+          ll += log(I);
+          I -= 1;
+        }
+      }
+      break;
+    case 2:                     // branch point s=(1,1)
+      ll += (I > 0 && I >= ell-1) ? log(Beta*S*I/pop) : R_NegInf;
+      S -= 1; I += 1;
+      ll -= log(I*(I-1)/2);
+      S = (S > 0) ? S : 0;
+      break;
+    }
+    return ll;
+  };
+
+  //! event rates, penalty, and total event rate of a block
+  void rates
+  (double *const x[], double ell,
+   double rate[][BLOCK], double *pen, double *tot) const {
+#pragma omp simd
+    for (int j = 0; j < BLOCK; j++) {
+      double S = x[0][j], I = x[1][j], R = x[2][j];
+      // 1 if I > ell, else 0; and the reverse
+      double free = std::min(std::max(I-ell,0.0),1.0);
+      double busy = std::min(std::max(ell+1-I,0.0),1.0);
+      // 0: transmission with saturation 0 or 1
+      // (if I = 0, then alpha = 0, so disc is immaterial)
+      double alpha = Beta*S*I/pop;
+      double disc = ell*(ell-1)/std::max(I*(I+1),2.0);
+      rate[0][j] = alpha*(1-disc);
+      pen[j] = alpha*disc;
+      // 1: recovery
+      alpha = gamma*I;
+      rate[1][j] = free*alpha;
+      pen[j] += busy*alpha;
+      // 2: loss of immunity
+      rate[2][j] = omega*R;
+      // sampling
+      pen[j] += (psi+chi)*I;
+      tot[j] = rate[0][j]+rate[1][j]+rate[2][j];
+    }
+  };
+
+};
+
+//! Integrate the filter equation from t0 to t1
+//! for the block of particles whose states are x and log weights ll.
+//! 'act' flags (with 1 or 0) the particles that take part.
+template <class MODEL>
+static void
+block_step
+(const MODEL& M, double *const x[], double *ll, double *act,
+ double ell, double t0, double t1)
+{
+  double rate[MODEL::nrate][BLOCK], cum[BLOCK], later[BLOCK];
+  double pen[BLOCK], tot[BLOCK], t[BLOCK], e[BLOCK], u[BLOCK];
+  double nact = 0;
+  for (int j = 0; j < BLOCK; j++) {
+    t[j] = t0;
+    nact += act[j];
+  }
+  while (nact > 0) {
+    M.rates(x,ell,rate,pen,tot);
+    // exponential deviates, by inversion
+    for (int j = 0; j < BLOCK; j++)
+      e[j] = (act[j] != 0) ? -log(unif_rand()) : 0;
+    // waiting times: particles whose next event lies beyond t1 are done
+#pragma omp simd
+    for (int j = 0; j < BLOCK; j++) {
+      double a = act[j];
+      double tstep = e[j]/std::max(tot[j],DBL_MIN);
+      double rest = t1-t[j];
+      act[j] = (tstep < rest) ? a : 0;
+      tstep = std::min(tstep,rest);
+      ll[j] -= a*pen[j]*tstep;
+      t[j] += a*tstep;
+    }
+    nact = 0;
+    for (int j = 0; j < BLOCK; j++) nact += act[j];
+    if (nact == 0) break;
+    for (int j = 0; j < BLOCK; j++)
+      u[j] = (act[j] != 0) ? unif_rand() : 0;
+    // choose the events as in 'rcateg', and apply them:
+    // the particles whose events come after the k-th
+    // get the difference between the jumps of events k+1 and k.
+#pragma omp simd
+    for (int j = 0; j < BLOCK; j++) {
+      u[j] *= tot[j];
+      cum[j] = 0;
+    }
+    for (int v = 0; v < MODEL::nvar; v++) {
+      double d = MODEL::jump[0][v];
+#pragma omp simd
+      for (int j = 0; j < BLOCK; j++) x[v][j] += act[j]*d;
+    }
+    for (int k = 0; k < MODEL::nrate-1; k++) {
+#pragma omp simd
+      for (int j = 0; j < BLOCK; j++) {
+        cum[j] += rate[k][j];
+        later[j] = (u[j] > cum[j]) ? act[j] : 0;
+      }
+      for (int v = 0; v < MODEL::nvar; v++) {
+        double d = MODEL::jump[k+1][v]-MODEL::jump[k][v];
+        if (d == 0) continue;
+#pragma omp simd
+        for (int j = 0; j < BLOCK; j++) x[v][j] += later[j]*d;
+      }
+    }
+  }
+}
+
+//! Bootstrap particle filter with np particles,
+//! as in 'pomp::pfilter' with the corresponding *_pomp object.
+//! if 'group' is true, simultaneous nodes are filtered in a single step.
+//! returns the estimated log likelihood.
+template <class MODEL, class TYPE>
+static double
+block_pfilter
+(const MODEL& M, const TYPE& G, size_t np, bool group)
+{
+  size_t n = G.length();
+  std::vector<double> tout(n+1);
+  std::vector<int> anc(n), lin(n), sat(n), type(n), deme(n), index(n), child(n);
+  G.gendat(tout.data(),anc.data(),lin.data(),sat.data(),
+           type.data(),deme.data(),index.data(),child.data());
+  size_t nb = (np+BLOCK-1)/BLOCK, npad = nb*BLOCK;
+  std::vector<double> X(MODEL::nvar*npad), Y(MODEL::nvar*npad), ll(npad);
+  std::vector<double> act(npad);
+  double *x[MODEL::nvar];
+  for (int v = 0; v < MODEL::nvar; v++) x[v] = X.data()+v*npad;
+  for (size_t j = 0; j < npad; j++) M.rinit(x,j);
+  double loglik = 0;
+  double ell = 0;
+  for (size_t k = 0; k < n; ) {
+    for (size_t j = 0; j < npad; j++) {
+      ll[j] = 0;
+      act[j] = (j < np) ? 1 : 0;
+    }
+    // singular portion of the filter equation,
+    // at the node or, if 'group', at each of the
+    // simultaneous nodes (cf. 'gendat')
+    double t0 = tout[k];
+    do {
+      switch (type[k]) {
+      case 0: ell += 1; break;                   // root
+      case 1: if (sat[k] == 0) ell -= 1; break;  // sample
+      case 2: ell += 1; break;                   // branch point
+      default: break;                            // #nocov
+      }
+      for (size_t j = 0; j < np; j++)
+        ll[j] += M.node(x,j,type[k],sat[k],ell);
+      k++;
+    } while (group && k < n && tout[k] == t0);
+    // continuous portion, block by block
+    if (tout[k] > t0) {
+      for (size_t b = 0; b < npad; b += BLOCK) {
+        double *xb[MODEL::nvar];
+        for (int v = 0; v < MODEL::nvar; v++) xb[v] = x[v]+b;
+        block_step(M,xb,ll.data()+b,act.data()+b,ell,t0,tout[k]);
+      }
+    }
+    // weights and systematic resampling
+    double lmax = R_NegInf;
+    for (size_t j = 0; j < np; j++)
+      if (ll[j] > lmax) lmax = ll[j];
+    if (!R_FINITE(lmax)) return R_NegInf;
+    double wsum = 0;
+    for (size_t j = 0; j < np; j++) wsum += (ll[j] = exp(ll[j]-lmax));
+    loglik += lmax+log(wsum/double(np));
+    double du = wsum/double(np), u = du*unif_rand(), w = ll[0];
+    for (size_t i = 0, j = 0; i < np; i++, u += du) {
+      while (u > w && j < np-1) w += ll[++j];
+      for (int v = 0; v < MODEL::nvar; v++) Y[v*npad+i] = x[v][j];
+    }
+    for (size_t i = np; i < npad; i++)
+      for (int v = 0; v < MODEL::nvar; v++) Y[v*npad+i] = Y[v*npad];
+    X.swap(Y);
+    for (int v = 0; v < MODEL::nvar; v++) x[v] = X.data()+v*npad;
+  }
+  return loglik;
+}
+
+extern "C" {
+
+  //! log likelihood of the genealogy, as estimated by a particle filter
+  //! with Np particles, at the parameters Params of the model named by Model
+  //! ("LBDP" or "SIRS"), simultaneous nodes being filtered in a single step
+  //! if Group is TRUE.
+  SEXP batch_pfilter (SEXP Object, SEXP Model, SEXP Params, SEXP Np, SEXP Group) {
+    const char *model = CHAR(STRING_ELT(Model,0));
+    int np = *INTEGER(AS_INTEGER(Np));
+    if (np == NA_INTEGER || np < 1)
+      err("in '%s': 'Np' must be a positive integer.",__func__); // #nocov
+    bool group = *LOGICAL(AS_LOGICAL(Group));
+    PROTECT(Params = AS_NUMERIC(Params));
+    const double *p = REAL(Params);
+    double ll = R_NaReal;
+    GetRNGstate();
+    if (strcmp(model,"LBDP") == 0) {
+      lbdp_block_t M(p);
+      with_genealogy(Object,pre_prune|pre_obscure,
+                     [&] (const auto& A) {ll = block_pfilter(M,A,np,group);});
+    } else if (strcmp(model,"SIRS") == 0) {
+      sirs_block_t M(p);
+      with_genealogy(Object,pre_prune|pre_obscure,
+                     [&] (const auto& A) {ll = block_pfilter(M,A,np,group);});
+    } else {
+      PutRNGstate();                                      // #nocov
+      err("in '%s': unrecognized model '%s'.",__func__,model); // #nocov
+    }
+    PutRNGstate();
+    UNPROTECT(1);
+    return ScalarReal(ll);
+  }
+
+}
@@ -0,0 +1,203 @@
+// -*- C++ -*-
+// CACHE of decoded genealogies
+
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <vector>
+
+#include "genealogy.h"
+#include "genview.h"
+#include "internal.h"
+
+//! Preprocessing steps applied to a genealogy before it is queried.
+typedef enum {
+  pre_prune = 1,                // drop black balls
+  pre_obscure = 2,              // erase demes
+  pre_zlb = 4                   // insert zero-length branches
+} preproc_t;
+
+//! Apply the indicated preprocessing (a combination of preproc_t flags).
+//! Lineages are always traced.
+template <class TYPE>
+TYPE& preprocess (TYPE& A, int how) {
+  if (how & pre_prune) A.prune();
+  if (how & pre_obscure) A.obscure();
+  A.trace_lineages();
+  if (how & pre_zlb) A.insert_zlb();
+  return A;
+}
+
+//! Cache of decoded, preprocessed genealogies.
+
+//! The same genealogy is often queried several times in succession
+//! (e.g., by 'getInfo', 'diagram', and 'cblv').
+//! The cache holds the genealogies most recently decoded for such queries,
+//! each with the preprocessing that was applied to it.
+//! An entry is found by a hash of the serialized payload,
+//! and a hit is confirmed by comparing the payload itself,
+//! so that a payload that has changed never finds a stale entry.
+//! Genealogies in the cache must not be modified.
+class gencache_t {
+
+private:
+
+  //! Maximum number of entries.
+  static const size_t capacity = 4;
+
+  struct entry_t {
+    uint64_t hash;
+    std::vector<raw_t> bytes;
+    int how;
+    genealogy_t *G;
+  };
+
+  //! Entries, most recently used first.
+  std::list<entry_t> _entries;
+
+private:
+
+  //! hash of a payload
+  static uint64_t hash (const raw_t *x, size_t n) {
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ n;
+    size_t k = 0;
+    for (; k+8 <= n; k += 8) {
+      uint64_t w;
+      memcpy(&w,x+k,sizeof(w));
+      h = (h ^ w) * 0x100000001b3ULL;
+      h ^= h >> 29;
+    }
+    for (; k < n; k++) {
+      h = (h ^ x[k]) * 0x100000001b3ULL;
+    }
+    h ^= h >> 32;
+    return h;
+  };
+
+  //! look up the payload x, of length n and hash h.
+  const genealogy_t* find (uint64_t h, const raw_t *x, size_t n, int how) {
+    for (auto i = _entries.begin(); i != _entries.end(); i++) {
+      if (i->hash == h && i->how == how && i->bytes.size() == n &&
+          (n == 0 || memcmp(i->bytes.data(),x,n) == 0)) {
+        _entries.splice(_entries.begin(),_entries,i);
+        return _entries.front().G;
+      }
+    }
+    return 0;
+  };
+
+public:
+
+  gencache_t (void) = default;
+  gencache_t (const gencache_t&) = delete;
+  gencache_t& operator= (const gencache_t&) = delete;
+  ~gencache_t (void) {
+    clear();
+  };
+
+  //! empty the cache, freeing the genealogies it holds.
+  void clear (void) {
+    for (entry_t &e : _entries) delete e.G;
+    _entries.clear();
+  };
+  //! look up the genealogy serialized in o, preprocessed as indicated.
+  //! returns 0 if there is no such entry.
+  const genealogy_t* find (SEXP o, int how) {
+    if (TYPEOF(o) != RAWSXP) return 0;
+    size_t n = XLENGTH(o);
+    return find(hash(RAW(o),n),RAW(o),n,how);
+  };
+  //! retrieve the genealogy serialized in o, preprocessed as indicated,
+  //! decoding and preprocessing it if it is not in the cache.
+  const genealogy_t* fetch (SEXP o, int how) {
+    PROTECT(o = AS_RAW(o));
+    const raw_t *x = RAW(o);
+    size_t n = XLENGTH(o);
+    uint64_t h = hash(x,n);
+    const genealogy_t *G = find(h,x,n,how);
+    if (G == 0) {
+      genealogy_t *A = new genealogy_t(o);
+      preprocess(*A,how);
+      G = A;
+      _entries.push_front({h,std::vector<raw_t>(x,x+n),how,A});
+      if (_entries.size() > capacity) {
+        delete _entries.back().G;
+        _entries.pop_back();
+      }
+    }
+    UNPROTECT(1);
+    return G;
+  };
+
+};
+
+//! the cache
+inline gencache_t& genealogy_cache (void) {
+  static gencache_t cache;
+  return cache;
+}
+
+//! apply f to the genealogy serialized in o, preprocessed as indicated.
+//! f is called with a genealogy_t or a genview_t.
+//! a genealogy already in the cache is reused;
+//! otherwise, the serialization is read in place where possible.
+template <class FUNC>
+void with_genealogy (SEXP o, int how, FUNC f) {
+  gencache_t& cache = genealogy_cache();
+  const genealogy_t *G = cache.find(o,how);
+  if (G == 0 && genview_t::readable(o)) {
+    genview_t V = o;
+    if (V.sorted()) {
+      f(preprocess(V,how));
+      return;
+    }
+  }
+  if (G == 0) G = cache.fetch(o,how);
+  f(*G);
+}
+
+//! apply f(k,A) to each genealogy A in the list Objects,
+//! preprocessed as indicated, k being its position in the list.
+//! as in 'cblv_array', the genealogies are read in place, in chunks,
+//! and f is applied in parallel, so it must be safe to do so.
+//! those that cannot be viewed in place are then decoded in the usual way,
+//! once the views of their chunk have been released.
+template <class FUNC>
+void for_each_genealogy (SEXP Objects, int how, int nthreads, FUNC f) {
+  size_t n = LENGTH(Objects);
+  if (nthreads < 1) nthreads = 1;
+  size_t chunk = 64*size_t(nthreads);
+  std::vector<genview_t> view;
+  std::vector<size_t> pos, rest;
+  view.reserve(chunk);
+  for (size_t c = 0; c < n; c += chunk) {
+    size_t m = (n-c < chunk) ? n-c : chunk;
+    for (size_t j = 0; j < m; j++) {
+      SEXP x = VECTOR_ELT(Objects,c+j);
+      if (genview_t::readable(x)) {
+        view.emplace_back(x);
+        if (view.back().sorted()) {
+          pos.push_back(c+j);
+          continue;
+        }
+        view.pop_back();
+      }
+      rest.push_back(c+j);
+    }
+    size_t nv = view.size();
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+    for (size_t i = 0; i < nv; i++) {
+      f(pos[i],preprocess(view[i],how));
+    }
+    view.clear();
+    pos.clear();
+    for (size_t k : rest)
+      f(k,*genealogy_cache().fetch(VECTOR_ELT(Objects,k),how));
+    rest.clear();
+  }
+}
+
+#endif
@@ -1,6 +1,9 @@
 #include "genealogy.h"
+#include "cache.h"
+#include "genview.h"
 #include "generics.h"
 #include "internal.h"
+#include <algorithm>
 #include <utility>
 #include <vector>
 
@@ -31,62 +34,99 @@ make_matrix
   return x;
 }
 
-slate_t
-node_t::joining_branch_length
-(const std::unordered_map<name_t, bool>& memo) const
-{
-  const node_t *p = parent();
-  while (!p->is_root() && !memo.at(p->uniq)) p = p->parent();
-  return slate - p->slate;
-}
-
-void node_t::cblv
+//! CBLV representation of a tree in dense form (see nodeseq_t::dense).
+//! each parent must precede its children.
+//! children are ladderized by decreasing subtree height;
+//! the tree is then traversed in order, without recursion.
+//! at each leaf, the length of the branch joining it to the part of the
+//! tree already visited is pushed into x; between successive children of
+//! an internal node, the height of that node is pushed into y.
+static std::pair<std::vector<slate_t>, std::vector<slate_t>>
+cblv_dense
 (
- std::vector<slate_t>& x,
- std::vector<slate_t>& y,
- std::unordered_map<name_t, bool>& memo,
- const std::unordered_map<name_t, std::vector<node_t*>>& children,
+ const std::vector<size_t>& par,
+ const std::vector<slate_t>& tm,
  slate_t t0
- ) const
+ )
 {
-  assert(!memo[uniq]);
-  const std::vector<node_t*>& ch = children.at(uniq);
-  if (ch.empty()) {
-    // leaf node: push joining branch length to x
-    x.push_back(joining_branch_length(memo));
-    memo[uniq] = true;
-  } else {
-    // first child: recurse
-    ch[0]->cblv(x, y, memo, children, t0);
-    // subsequent children:
-    for (size_t i = 1; i < ch.size(); i++) {
-      // push the height of current node into y
-      y.push_back(slate - t0);
-      memo[uniq] = true;
-      ch[i]->cblv(x, y, memo, children, t0);
+  size_t n = par.size();
+  // children of node i are kid[first[i]], ..., kid[first[i+1]-1],
+  // initially in sequence order.
+  std::vector<size_t> first(n+1,0), kid(n), roots;
+  for (size_t i = 0; i < n; i++) {
+    if (par[i] != i) first[par[i]+1]++;
+    else roots.push_back(i);
+  }
+  for (size_t i = 0; i < n; i++) first[i+1] += first[i];
+  std::vector<size_t> fill(first.begin(),first.end()-1);
+  for (size_t i = 0; i < n; i++) {
+    if (par[i] != i) kid[fill[par[i]]++] = i;
+  }
+  // ladderize
+  std::vector<slate_t> height(n);
+  auto taller = [&height](size_t a, size_t b) {
+    return height[a] > height[b];
+  };
+  for (size_t i = n; i-- > 0; ) {
+    if (first[i] == first[i+1]) {
+      height[i] = tm[i];
+    } else {
+      std::sort(kid.begin()+first[i],kid.begin()+first[i+1],taller);
+      height[i] = height[kid[first[i]]];
     }
   }
+  std::sort(roots.begin(),roots.end(),taller);
+  // traverse.
+  // 'anchor' is the nearest ancestor that is a root or already visited;
+  // a node is visited once the subtree of its first child has been.
+  struct frame_t {
+    size_t node, next, anchor;
+  };
+  std::vector<slate_t> x, y;
+  std::vector<frame_t> stack;
+  x.reserve(n); y.reserve(n);
+  for (size_t r : roots) {
+    stack.push_back({r,0,r});
+    while (!stack.empty()) {
+      frame_t &f = stack.back();
+      size_t i = f.node, k = first[i]+f.next;
+      if (first[i] == first[i+1]) { // leaf
+        x.push_back(tm[i]-tm[f.anchor]);
+        stack.pop_back();
+      } else if (f.next == 0) {        // first child
+        f.next++;
+        stack.push_back({kid[k],0,(par[i] == i) ? i : f.anchor});
+      } else if (k < first[i+1]) {      // subsequent children
+        f.next++;
+        y.push_back(tm[i]-t0);
+        stack.push_back({kid[k],0,i});
+      } else {
+        stack.pop_back();
+      }
+    }
+    y.push_back(slate_t(0));
+  }
+  return {x, y};
 }
 
 std::pair<std::vector<slate_t>, std::vector<slate_t>>
 genealogy_t::cblv
 (void) const
 {
-  auto children = children_map();
-  auto roots  = ladderize(children);
-  std::vector<slate_t> x, y;
-  x.reserve(nsample());
-  y.reserve(nsample());
-  std::unordered_map<name_t, bool> memo;
-  memo.reserve(size());
-  for (node_t* p : *this) memo[p->uniq] = false;
-  slate_t t0 = timezero();
-  for (node_t* p : roots) {
-    p->cblv(x, y, memo, children, t0);
-    y.push_back(slate_t(0));
-    memo[p->uniq] = true;
-  }
-  return {x, y};
+  std::vector<size_t> par;
+  std::vector<slate_t> tm;
+  dense(par,tm);
+  return cblv_dense(par,tm,timezero());
+}
+
+std::pair<std::vector<slate_t>, std::vector<slate_t>>
+genview_t::cblv
+(void) const
+{
+  std::vector<size_t> par;
+  std::vector<slate_t> tm;
+  dense(par,tm);
+  return cblv_dense(par,tm,timezero());
 }
 
 genealogy_t&
@@ -146,16 +186,18 @@ genealogy_t::parse_cblv
   return *this;
 }
 
+//! the genealogy should already have been pruned and obscured
+//! and its zero-length branches inserted.
 SEXP
 cblv
-(genealogy_t& A)
+(const genealogy_t& A)
 {
   const char *colnames[] = {"tip","node"};
   double *x, *y;
   size_t i, n;
   SEXP S;
   std::pair<std::vector<slate_t>, std::vector<slate_t>> rep;
-  rep = A.prune().obscure().insert_zlb().cblv();
+  rep = A.cblv();
   n = rep.first.size();
   PROTECT(S = make_matrix(n,2,colnames));
   x = REAL(S);
@@ -172,8 +214,69 @@ extern "C" {
 
   //! construct CBLV representation as a matrix
   SEXP cblv (SEXP State) {
-    genealogy_t A = State;
-    return cblv(A);
+    const genealogy_t *A =
+      genealogy_cache().fetch(State,pre_prune|pre_obscure|pre_zlb);
+    return cblv(*A);
+  }
+
+  //! CBLV representations of a list of genealogies,
+  //! in an array of dimension (genealogies, tips, 2), padded with zeros.
+  //! the array has as many rows as the largest genealogy has tips,
+  //! unless MaxTips is given.
+  //! the genealogies are read in place and encoded in parallel,
+  //! in chunks, so that only those of one chunk are held in memory
+  //! at a time.
+  //! those that cannot be viewed in place are decoded in the usual way.
+  SEXP cblv_array (SEXP Objects, SEXP MaxTips, SEXP Nthreads) {
+    const char *nm[] = {"tip","node"};
+    typedef std::pair<std::vector<slate_t>, std::vector<slate_t>> rep_t;
+    size_t n = LENGTH(Objects);
+    int nthreads = *INTEGER(AS_INTEGER(Nthreads));
+    if (nthreads == NA_INTEGER || nthreads < 1) nthreads = 1;
+    std::vector<rep_t> rep(n);
+    for_each_genealogy(Objects,pre_prune|pre_obscure|pre_zlb,nthreads,
+                       [&] (size_t k, const auto& A) {
+                         rep[k] = A.cblv();
+                       });
+    size_t ntip = 0;
+    for (size_t i = 0; i < n; i++) {
+      if (ntip < rep[i].first.size()) ntip = rep[i].first.size();
+    }
+    int maxtips = *INTEGER(AS_INTEGER(MaxTips));
+    if (maxtips != NA_INTEGER) {
+      if (maxtips < 0 || size_t(maxtips) < ntip)
+        err("in '%s': a genealogy has %zu tips, more than 'max_tips' = %d.",
+            __func__,ntip,maxtips);
+      ntip = size_t(maxtips);
+    }
+    SEXP out, dim, dimnm, nt;
+    PROTECT(dim = NEW_INTEGER(3));
+    INTEGER(dim)[0] = int(n);
+    INTEGER(dim)[1] = int(ntip);
+    INTEGER(dim)[2] = 2;
+    PROTECT(out = Rf_allocArray(REALSXP,dim));
+    PROTECT(dimnm = NEW_LIST(3));
+    SET_ELEMENT(dimnm,2,NEW_CHARACTER(2));
+    for (int k = 0; k < 2; k++)
+      SET_STRING_ELT(VECTOR_ELT(dimnm,2),k,mkChar(nm[k]));
+    SET_DIMNAMES(out,dimnm);
+    PROTECT(nt = NEW_INTEGER(n));
+    double *x = REAL(out);
+    double *y = x+n*ntip;
+    int *ntp = INTEGER(nt);
+#pragma omp parallel for num_threads(nthreads)
+    for (size_t i = 0; i < n; i++) {
+      size_t k = rep[i].first.size();
+      ntp[i] = int(k);
+      for (size_t j = 0; j < ntip; j++) {
+        x[i+n*j] = (j < k) ? rep[i].first[j] : 0;
+        y[i+n*j] = (j < k) ? rep[i].second[j] : 0;
+      }
+      rep_t().swap(rep[i]);
+    }
+    SET_ATTR(out,install("ntip"),nt);
+    UNPROTECT(4);
+    return out;
   }
 
   //! parse CBLV representation
@@ -0,0 +1,126 @@
+// -*- C++ -*-
+// Primitives for the compact binary serialization.
+
+#ifndef _CODEC_H_
+#define _CODEC_H_
+
+#include <cstdint>
+#include <cstring>
+#include "internal.h"
+
+//! Compact serialization primitives.
+
+//! All multi-byte quantities are written least-significant byte first,
+//! so the encoded form does not depend on the byte order of the machine.
+//! - unsigned integers are written as LEB128 varints (7 bits per byte);
+//! - signed integers are zigzag-mapped to unsigned ones first;
+//! - times are written as the XOR of their bit-pattern with that of
+//!   a reference time (typically the preceding one), stripped of leading
+//!   and trailing zero bytes and prefixed by a control byte.
+//!   Coincident times thus cost one byte and nearby times few.
+
+//! number of bytes in the varint encoding of x
+static inline size_t varint_size (uint64_t x) {
+  size_t n = 1;
+  while (x >= 0x80) {
+    x >>= 7; n++;
+  }
+  return n;
+}
+
+//! write x as a varint
+static inline raw_t* put_varint (raw_t *o, uint64_t x) {
+  while (x >= 0x80) {
+    *(o++) = raw_t(x | 0x80);
+    x >>= 7;
+  }
+  *(o++) = raw_t(x);
+  return o;
+}
+
+//! read a varint into x
+template <class INT>
+static inline raw_t* get_varint (raw_t *o, INT &x) {
+  uint64_t u = 0;
+  int shift = 0;
+  while (*o & 0x80) {
+    u |= uint64_t(*(o++) & 0x7f) << shift;
+    shift += 7;
+  }
+  u |= uint64_t(*(o++)) << shift;
+  x = INT(u);
+  return o;
+}
+
+//! map a signed integer onto an unsigned one, small magnitudes to small values
+static inline uint64_t zigzag (int64_t x) {
+  return (uint64_t(x) << 1) ^ uint64_t(x >> 63);
+}
+
+//! inverse of zigzag
+static inline int64_t unzigzag (uint64_t x) {
+  return int64_t(x >> 1) ^ -int64_t(x & 1);
+}
+
+//! bit-pattern of a time
+static inline uint64_t slate_bits (slate_t t) {
+  uint64_t u;
+  memcpy(&u,&t,sizeof(u));
+  return u;
+}
+
+//! XOR-difference between t and reference time r
+static inline uint64_t slate_xor (slate_t t, slate_t r) {
+  return slate_bits(t) ^ slate_bits(r);
+}
+
+//! leading and trailing zero bytes of x.
+//! zero is held to have 8 leading and no trailing zero bytes.
+static inline void zero_bytes (uint64_t x, int &lead, int &trail) {
+  lead = trail = 0;
+  if (x == 0) {
+    lead = 8;
+  } else {
+    while ((x >> (56-8*lead)) == 0) lead++;
+    while (((x >> (8*trail)) & 0xff) == 0) trail++;
+  }
+}
+
+//! number of bytes in the encoding of t relative to r
+static inline size_t slate_size (slate_t t, slate_t r) {
+  int lead, trail;
+  zero_bytes(slate_xor(t,r),lead,trail);
+  return 9-lead-trail;
+}
+
+//! write t relative to r
+static inline raw_t* put_slate (raw_t *o, slate_t t, slate_t r) {
+  uint64_t x = slate_xor(t,r);
+  int lead, trail;
+  zero_bytes(x,lead,trail);
+  *(o++) = raw_t((lead << 4) | trail);
+  x >>= 8*trail;
+  for (int k = lead+trail; k < 8; k++) {
+    *(o++) = raw_t(x & 0xff);
+    x >>= 8;
+  }
+  return o;
+}
+
+//! read a time written relative to r
+static inline raw_t* get_slate (raw_t *o, slate_t &t, slate_t r) {
+  int lead = (*o >> 4) & 0x0f;
+  int trail = *o & 0x0f;
+  o++;
+  if (lead+trail > 8)
+    err("in %s: corrupted genealogy serialization.",__func__); // #nocov
+  uint64_t x = 0;
+  for (int k = 0; k < 8-lead-trail; k++) {
+    x |= uint64_t(*(o++)) << (8*(trail+k));
+  }
+  x ^= slate_bits(r);
+  memcpy(&t,&x,sizeof(t));
+  return o;
+}
+
+#endif
@@ -2,8 +2,11 @@
 // i.e., shrink the time-interval on which it is defined.
 
 #include "genealogy.h"
+#include "cache.h"
 #include "generics.h"
 #include "internal.h"
+#include <unordered_map>
+#include <vector>
 
 //! curtail the genealogy by removing nodes
 //! with times later than tnew and/or earlier than troot
@@ -43,6 +46,9 @@ genealogy_t::curtail
   }
   time() = tnew;
   if (!empty() && troot > timezero()) {
+    // new nodes at troot are placed in order from here on
+    node_nit h = begin();
+    while (h != end() && (*h)->slate < troot) h++;
     node_t *p = front();
     node_t *q;
     while (!empty() && p->slate < troot) {
@@ -57,7 +63,7 @@ genealogy_t::curtail
         case black:
           q = make_node(b->deme());
           q->slate = troot;
-          move(b,p,q); push_back(q);
+          move(b,p,q); place(q,h);
           break;
         case green:
           q = b->child();
@@ -70,7 +76,7 @@ genealogy_t::curtail
           } else {
             node_t *pp = make_node(b->deme());
             pp->slate = troot;
-            move(b,p,pp); push_back(pp);
+            move(b,p,pp); place(pp,h);
           }
           break;
         }
@@ -78,11 +84,134 @@ genealogy_t::curtail
       destroy_node(p);
       if (!empty()) p = front();
     }
-    sort();
+    reorder();
   }
   if (troot > timezero()) timezero() = troot;
 }
 
+//! the genealogy as curtailed to [troot, tnew],
+//! with the same result as a copy curtailed by 'curtail'.
+//! only the nodes in the window (and the new roots at troot) are made.
+//! nodes beyond tnew are visited once, from the back,
+//! to find the ball each such subtree leaves as a black ball
+//! in its latest surviving ancestor.
+//! nodes before troot are visited once, from the front,
+//! to make the new roots at troot, in the same order as 'curtail'.
+//! W should be empty.
+void
+genealogy_t::window
+(slate_t tnew, slate_t troot, genealogy_t& W) const
+{
+  typedef std::pair<name_t,name_t> black_t; // (uniq, deme)
+  assert(W.empty());
+  if (tnew < troot) troot = tnew;
+  W._unique = _unique;
+  W._ndeme = _ndeme;
+  W.timezero() = timezero();
+  W.time() = tnew;
+  bool cutlo = (troot > timezero());
+  // the late end: the survivor of each subtree beyond tnew
+  std::unordered_map<const node_t*,name_t> least;
+  std::unordered_map<const node_t*,std::vector<black_t>> extra;
+  for (node_rev_it i = crbegin(); i != crend() && (*i)->slate > tnew; i++) {
+    const node_t *p = *i;
+    if (p->is_root()) continue;
+    bool hasblue = false;
+    name_t u = 0;
+    auto j = least.find(p);
+    bool hasblack = (j != least.end());
+    if (hasblack) u = j->second;
+    for (const ball_t *b : *p) {
+      if (b->is(blue)) {
+        if (!hasblue || b->uniq < u) u = b->uniq;
+        hasblue = true;
+      } else if (b->is(black) && !hasblue) {
+        if (!hasblack || b->uniq < u) u = b->uniq;
+        hasblack = true;
+      }
+    }
+    const node_t *q = p->parent();
+    if (q->slate > tnew) {
+      auto k = least.find(q);
+      if (k == least.end()) least[q] = u;
+      else if (u < k->second) k->second = u;
+    } else {
+      extra[q].push_back(black_t(u,p->deme()));
+    }
+  }
+  // the nodes within the window
+  std::unordered_map<const node_t*,node_t*> copy;
+  bool any = false;
+  for (const node_t *p : *this) {
+    if (p->slate > tnew) break;
+    any = true;
+    if (cutlo && p->slate < troot) continue;
+    node_t *q = new node_t(p->uniq,p->slate);
+    q->lineage() = p->lineage();
+    ball_t *g = new ball_t(q,p->uniq,green,p->deme());
+    q->green_ball() = g;
+    if (p->is_root()) {
+      q->insert(g);
+    } else {
+      auto k = copy.find(p->parent());
+      if (k != copy.end()) k->second->insert(g);
+    }
+    for (const ball_t *b : *p) {
+      if (!b->is(green)) q->insert(new ball_t(q,b->uniq,b->color,b->deme()));
+    }
+    auto k = extra.find(p);
+    if (k != extra.end()) {
+      for (const black_t& x : k->second)
+        q->insert(new ball_t(q,x.first,black,x.second));
+    }
+    copy[p] = q;
+    W.push_back(q);
+  }
+  // the early end: new roots at troot
+  if (any && cutlo) {
+    node_nit h = W.begin();
+    std::vector<black_t> blk;
+    std::vector<const node_t*> kid;
+    for (const node_t *p : *this) {
+      if (p->slate >= troot) break;
+      blk.clear(); kid.clear();
+      for (const ball_t *b : *p) {
+        if (b->is(black)) {
+          blk.push_back(black_t(b->uniq,b->deme()));
+        } else if (b->is(green) && b->child() != p &&
+                   b->child()->slate <= tnew) {
+          kid.push_back(b->child());
+        }
+      }
+      auto k = extra.find(p);
+      if (k != extra.end())
+        blk.insert(blk.end(),k->second.begin(),k->second.end());
+      std::sort(blk.begin(),blk.end());
+      for (auto x = blk.rbegin(); x != blk.rend(); x++) {
+        node_t *q = W.make_node(x->second);
+        q->slate = troot;
+        q->insert(new ball_t(q,x->first,black,x->second));
+        W.place(q,h);
+      }
+      // the children are taken from the last down to p itself,
+      // then from the first up
+      size_t m = 0;
+      while (m < kid.size() && kid[m]->uniq < p->uniq) m++;
+      std::reverse(kid.begin()+m,kid.end());
+      std::rotate(kid.begin(),kid.begin()+m,kid.end());
+      for (const node_t *c : kid) {
+        if (c->slate < troot) continue;
+        node_t *q = W.make_node(c->deme());
+        q->slate = troot;
+        q->insert(copy.at(c)->green_ball());
+        W.place(q,h);
+      }
+    }
+    W.reorder();
+  }
+  if (cutlo) W.timezero() = troot;
+}
+
 extern "C" {
 
   //! curtail the given genealogy
@@ -101,4 +230,52 @@ extern "C" {
     return out;
   }
 
+  //! information about the genealogy as curtailed to each of several
+  //! windows, [T0[k], Time[k]] (recycled); NA denotes the full extent.
+  //! the genealogy is decoded just once;
+  //! each window is built from it directly, without copying it.
+  //! zero-length branches are inserted unless Extended is true.
+  SEXP curtail_info (SEXP State, SEXP Time, SEXP T0,
+                     SEXP Prune, SEXP Obscure, SEXP Extended,
+                     SEXP Newick, SEXP Lineages, SEXP Gendat) {
+    const genealogy_t *G = genealogy_cache().fetch(State,0);
+    PROTECT(Time = AS_NUMERIC(Time));
+    PROTECT(T0 = AS_NUMERIC(T0));
+    size_t nt = LENGTH(Time), n0 = LENGTH(T0);
+    size_t n = (nt == 0 || n0 == 0) ? 0 : ((nt > n0) ? nt : n0);
+    bool extended = *LOGICAL(AS_LOGICAL(Extended));
+    bool nwk = *LOGICAL(AS_LOGICAL(Newick));
+    bool lin = *LOGICAL(AS_LOGICAL(Lineages));
+    bool gd = *LOGICAL(AS_LOGICAL(Gendat));
+    int how = (*LOGICAL(AS_LOGICAL(Prune)) ? pre_prune : 0) |
+      (*LOGICAL(AS_LOGICAL(Obscure)) ? pre_obscure : 0) |
+      (extended ? 0 : pre_zlb);
+    size_t nout = 2 + nwk + lin + gd;
+    SEXP out;
+    PROTECT(out = NEW_LIST(n));
+    for (size_t j = 0; j < n; j++) {
+      double t = REAL(Time)[j % nt], t0 = REAL(T0)[j % n0];
+      if (ISNA(t)) t = G->time();
+      if (ISNA(t0)) t0 = G->timezero();
+      genealogy_t W;
+      G->window(t,t0,W);
+      W.trace_lineages();
+      preprocess(W,how);
+      SEXP x, xn;
+      PROTECT(x = NEW_LIST(nout));
+      PROTECT(xn = NEW_CHARACTER(nout));
+      int k = 0;
+      k = set_list_elem(x,xn,timezero(W),"t0",k);
+      k = set_list_elem(x,xn,time(W),"time",k);
+      if (nwk) k = set_list_elem(x,xn,newick(W,extended),"newick",k);
+      if (lin) k = set_list_elem(x,xn,lineage_count(W),"lineages",k);
+      if (gd) k = set_list_elem(x,xn,gendat(W),"gendat",k);
+      SET_NAMES(x,xn);
+      SET_ELEMENT(out,j,x);
+      UNPROTECT(2);
+    }
+    UNPROTECT(3);
+    return out;
+  }
+
 }
@@ -0,0 +1,423 @@
+// -*- C++ -*-
+// FILTER class
+
+#ifndef _FILTER_H_
+#define _FILTER_H_
+
+#include "internal.h"
+
+extern "C" {
+#include "pomplink.h"
+}
+
+//! The kinds of genealogical action an event can have.
+
+//! These are the actions of the master process (cf. 'master_t'),
+//! as they bear on the filter equation.
+//! A migration into, or destructive sampling into, a deme whose size is
+//! not tracked (e.g., a deme of the dead) is a death, or a destructive
+//! sample, respectively.
+//! The arrival of a new host from such a deme is an importation.
+//! Since grafted lineages are rooted at the initial time,
+//! the lineages that are yet to be imported lie, until they are,
+//! in the untracked deme from which they come.
+typedef enum {
+  nothing = 0,                  // no lineage is involved
+  birthing,                     // birth in deme 'to' of a parent in deme 'from'
+  dying,                        // death in deme 'from'
+  migrating,                    // migration from deme 'from' to deme 'to'
+  importing,                    // arrival of a new host from deme 'from' into deme 'to'
+  sampling,                     // non-destructive sample in deme 'from'
+  culling                       // destructive sample in deme 'from'
+} action_kind_t;
+
+//! The genealogical action of an event.
+typedef struct {
+  action_kind_t kind;
+  int from;
+  int to;
+} action_t;
+
+//! Filter-equation class.
+
+//! The class for the solution of the filter equation,
+//! for the pomp-based particle filter.
+//! - STATE is a datatype that holds the state of the Markov process.
+//! - PARAMETERS is a datatype for the model parameters
+//! - NEVENT is the number of event-types
+//! - NDEME is the number of demes
+//!
+//! The model-specific members (the event rates, the jumps, the deme sizes,
+//! and the genealogical action of each event) are supplied by
+//! specialization, as for 'popul_proc_t'.
+//! The state variables of the 'pomp' object are those of the model,
+//! followed by the numbers of lineages in each deme ('ell'),
+//! the accumulated weight ('ll'), the current node number ('node'),
+//! and the coloring of each lineage ('color').
+template <class STATE, class PARAMETERS, size_t NEVENT, size_t NDEME>
+class filter_t {
+
+public:
+  // TYPE DEFINITIONS
+  typedef STATE state_t;
+  typedef PARAMETERS parameters_t;
+  static const size_t nevent = NEVENT;
+  static const size_t ndeme = NDEME;
+
+public:
+  // MEMBER DATA
+  state_t state;                // current state
+  parameters_t params;          // model parameters
+  double ell[NDEME+1];          // numbers of lineages in each deme
+  static const action_t action[NEVENT]; // genealogical actions
+
+public:
+  // MODEL-SPECIFIC MEMBERS
+  //! number of state variables
+  static const int nvar;
+  //! read the parameters
+  void get_params (const double *p, const int *pidx);
+  //! read the state
+  void get_state (const double *x, const int *sidx);
+  //! write the state
+  void put_state (double *x, const int *sidx) const;
+  //! initialize the state
+  void rinit (void);
+  //! compute event rates
+  double event_rates (double *rate, int n) const;
+  //! makes a jump
+  void jump (int e);
+  //! size of a deme (negative if it is not tracked)
+  double size (int d) const;
+
+public:
+  // the genealogical actions are accounted for by the filter equation:
+  // in the model-specific jumps, they do nothing.
+  void birth (name_t i = 1, name_t j = 1, int n = 1) {};
+  void death (name_t i = 1) {};
+  void graft (name_t i = 1, int m = 1) {};
+  void sample (name_t i = 1, int n = 1) {};
+  void sample_death (name_t i = 1, int n = 1) {};
+  void migrate (name_t i = 1, name_t j = 1) {};
+  void sample_migrate (name_t i = 1, name_t j = 1) {};
+
+private:
+
+  static double pos (double x) {
+    return (x > 0) ? x : 0;
+  };
+
+  //! is there an importation from deme d?
+  static bool imports_from (int d) {
+    for (size_t e = 0; e < NEVENT; e++)
+      if (action[e].kind == importing && action[e].from == d) return true;
+    return false;
+  };
+
+  //! change the color of the n-th lineage of color 'from' to 'to'
+  static void recolor (double *color, int nsample, int n, int from, int to) {
+    int i = -1;
+    while (n >= 0 && i < nsample) {
+      i++;
+      if (!ISNA(color[i]) && nearbyint(color[i]) == from) n--;
+    }
+    assert(i < nsample);
+    color[i] = to;
+  };
+
+  //! Rates of the events of the filter equation.
+
+  //! Each event e of the model gives rise to two:
+  //! rate[2*e] is that at which it occurs without moving a lineage,
+  //! rate[2*e+1] that at which it moves one from deme 'from' to 'to'.
+  //! The rates are those of the master process,
+  //! weighted by the probability that the event is compatible with
+  //! the genealogy, given the numbers of lineages in each deme,
+  //! and by the changes in the numbers of ways of placing these;
+  //! the balance goes into the penalty.
+  double filter_rates (double *rate, double *penalty) const {
+    double alpha[NEVENT];
+    double total = 0;
+    *penalty = 0;
+    event_rates(alpha,NEVENT);
+    for (size_t e = 0; e < NEVENT; e++) {
+      const action_t &A = action[e];
+      double a = alpha[e], r0 = 0, r1 = 0;
+      double na = (A.from > 0) ? size(A.from) : 0;
+      double la = (A.from > 0) ? ell[A.from] : 0;
+      double nb = (A.to > 0) ? size(A.to) : 0;
+      double lb = (A.to > 0) ? ell[A.to] : 0;
+      switch (A.kind) {
+      case nothing:
+        r0 = a;
+        break;
+      case birthing:
+        if (A.from == A.to) {
+          double disc = (na > 0) ? la*(la-1)/na/(na+1) : 1;
+          r0 = a*pos(1-disc);
+        } else {
+          r0 = a*pos(1-lb/(nb+1));
+          r1 = (na > 0) ? a*la*pos(na-la+1)/na/(nb+1) : 0;
+        }
+        break;
+      case dying:
+        r0 = (na > la) ? a : 0;
+        break;
+      case migrating:
+        r0 = (na > la) ? a*pos(1-lb/(nb+1)) : 0;
+        r1 = a*la/(nb+1);
+        break;
+      case importing:
+        r0 = a*pos(1-lb/(nb+1));
+        r1 = a*la/(nb+1);
+        break;
+      case sampling: case culling: default:
+        break;
+      }
+      total += (rate[2*e] = r0);
+      total += (rate[2*e+1] = r1);
+      *penalty += a-r0-r1;
+    }
+    return total;
+  };
+
+  //! Singular portion of the filter equation at a node.
+  void node_jump
+  (
+   int parent, double *color, double *ll,
+   int nsample, const int *nodetype, const int *nodedeme,
+   const int *lineage, const int *sat, const int *index, const int *child
+   ) {
+    double alpha[NEVENT], rate[NEVENT];
+    int parlin = lineage[parent];
+    assert(parlin >= 0 && parlin < nsample);
+    switch (nodetype[parent]) {
+    default:                    // non-genealogical event #nocov
+      break;                    // #nocov
+    case 0: {                   // root
+      // color lineages by sampling without replacement
+      assert(sat[parent]==1);
+      int c = child[index[parent]];
+      double free[NDEME], total = 0;
+      int d = 0;
+      for (size_t i = 0; i < NDEME; i++) {
+        double n = size(i+1);
+        if (n >= 0) {
+          free[i] = pos(n-ell[i+1]);
+          if (d == 0) d = i+1;
+        } else {
+          // the lineage may await importation from an untracked deme;
+          // the weight of this proposal is arbitrary, and is corrected for
+          free[i] = (imports_from(i+1)) ? 1 : 0;
+        }
+        total += free[i];
+      }
+      if (total > 0) {
+        d = rcateg(total,free,NDEME)+1;
+        *ll -= log(free[d-1]/total);
+      } else {                  // more roots than hosts
+        *ll += R_NegInf;        // this is incompatible with the genealogy
+      }
+      color[lineage[c]] = d;
+      ell[d] += 1;
+    }
+      break;
+    case 1: {                   // sample
+      // the lineage must lie in the observed deme
+      int d = nodedeme[parent];
+      int a = nearbyint(color[parlin]);
+      double n = size(a);
+      double total = 0;
+      event_rates(alpha,NEVENT);
+      for (size_t e = 0; e < NEVENT; e++) {
+        const action_t &A = action[e];
+        rate[e] = (A.from == a && d == a &&
+                   (A.kind == sampling || (A.kind == culling && sat[parent] == 0))) ?
+          alpha[e] : 0;
+        total += rate[e];
+      }
+      if (total > 0 && n > 0) {
+        *ll += log(total/n);
+      } else {
+        *ll += R_NegInf;
+      }
+      int e = (total > 0) ? rcateg(total,rate,NEVENT) : -1;
+      if (sat[parent] == 1) {   // sampled ancestor
+        int c = child[index[parent]];
+        color[lineage[c]] = a;
+      } else if (sat[parent] == 0) { // tip
+        ell[a] -= 1;
+        if (e >= 0 && action[e].kind == sampling) { // non-destructive sample
+          *ll += log(n-ell[a]);
+        } else if (e >= 0) {    // destructive sample
+          *ll += log(n);
+        }
+      } else {
+        assert(0);              // #nocov
+        *ll += R_NegInf;        // #nocov
+      }
+      if (e >= 0) jump(e);
+      color[parlin] = R_NaReal;
+    }
+      break;
+    case 2: {                   // branch point
+      assert(sat[parent]==2);
+      int a = nearbyint(color[parlin]);
+      double total = 0;
+      event_rates(alpha,NEVENT);
+      for (size_t e = 0; e < NEVENT; e++) {
+        rate[e] = (action[e].kind == birthing && action[e].from == a) ? alpha[e] : 0;
+        total += rate[e];
+      }
+      int c1 = child[index[parent]];
+      int c2 = child[index[parent]+1];
+      assert(c1 != c2);
+      assert(lineage[c1] == parlin || lineage[c2] == parlin);
+      if (total > 0) {
+        int e = rcateg(total,rate,NEVENT);
+        int b = action[e].to;
+        double na = size(a), nb = size(b);
+        *ll += log(total);
+        if (b == a) {           // both children in deme a
+          color[lineage[c1]] = a;
+          color[lineage[c2]] = a;
+          *ll -= log(na*(na+1)/2);
+        } else {                // one child in each of demes a and b
+          if (unif_rand() < 0.5) {
+            color[lineage[c1]] = a;
+            color[lineage[c2]] = b;
+          } else {
+            color[lineage[c1]] = b;
+            color[lineage[c2]] = a;
+          }
+          *ll -= log(0.5);
+          *ll -= log(na*(nb+1));
+        }
+        ell[b] += 1;
+        jump(e);
+      } else {                  // the genealogy is incompatible with the state
+        *ll += R_NegInf;
+        color[lineage[c1]] = a;
+        color[lineage[c2]] = a;
+        ell[a] += 1;
+      }
+    }
+      break;
+    }
+  };
+
+public:
+
+  //! Latent-state initializer (rinit component).
+  static void pomp_rinit
+  (
+   double *x, const double *p,
+   const int *sidx, const int *pidx
+   ) {
+    filter_t F;
+    F.get_params(p,pidx);
+    F.rinit();
+    F.put_state(x,sidx);
+    for (size_t d = 0; d < NDEME; d++) x[sidx[nvar+d]] = 0;
+    x[sidx[nvar+NDEME]] = 0;    // ll
+    x[sidx[nvar+NDEME+1]] = 0;  // node
+  };
+
+  //! Simulator for the latent-state process (rprocess component).
+
+  //! This is the Gillespie algorithm applied to the solution of the
+  //! filter equation.
+  //! It advances the state from time `t` to time `t+dt`.
+  //!
+  //! As in the model-specific kernels, the state must remain valid
+  //! even when it is incompatible with the genealogy.
+  //! In such a case, the log likelihood ('ll') is set to `R_NegInf`.
+  static void pomp_step
+  (
+   double *x, const double *p,
+   const int *sidx, const int *pidx,
+   double t, double dt
+   ) {
+    double tstep = 0.0, tmax = t + dt;
+    double &ll = x[sidx[nvar+NDEME]];
+    double &node = x[sidx[nvar+NDEME+1]];
+    double *color = &x[sidx[nvar+NDEME+2]];
+    const int nsample = *get_userdata_int("nsample");
+    const int *nodetype = get_userdata_int("nodetype");
+    const int *group = get_userdata_int("group");
+    const int nnode = *get_userdata_int("nnode");
+    const int *nodedeme = get_userdata_int("deme");
+    const int *lineage = get_userdata_int("lineage");
+    const int *sat = get_userdata_int("saturation");
+    const int *index = get_userdata_int("index");
+    const int *child = get_userdata_int("child");
+
+    filter_t F;
+    F.get_params(p,pidx);
+    F.get_state(x,sidx);
+    F.ell[0] = 0;
+    for (size_t d = 0; d < NDEME; d++) F.ell[d+1] = x[sidx[nvar+d]];
+
+    int parent = (int) nearbyint(node);
+    assert(parent>=0);
+    assert(parent<=nnode);
+
+    ll = 0;
+
+    // singular portion of filter equation,
+    // at each of the simultaneous nodes of the group
+    do {
+      F.node_jump(parent,color,&ll,nsample,nodetype,nodedeme,
+                  lineage,sat,index,child);
+    } while (++parent < nnode && group[parent] == group[parent-1]);
+
+    // continuous portion of filter equation:
+    // take Gillespie steps to the end of the interval
+    if (tmax > t && R_FINITE(ll)) {
+
+      double rate[2*NEVENT];
+      double penalty = 0;
+      double event_rate = F.filter_rates(rate,&penalty);
+
+      while (t < tmax) {
+        tstep = exp_rand()/event_rate;
+        if (t + tstep >= tmax) break;
+        int e = rcateg(event_rate,rate,2*NEVENT);
+        ll -= penalty*tstep;
+        const action_t &A = action[e/2];
+        if (e % 2) {            // the event moves a lineage
+          recolor(color,nsample,random_integer(F.ell[A.from]),A.from,A.to);
+          F.ell[A.from] -= 1;
+          F.ell[A.to] += 1;
+        }
+        F.jump(e/2);
+        t += tstep;
+        event_rate = F.filter_rates(rate,&penalty);
+      }
+      tstep = tmax - t;
+      ll -= penalty*tstep;
+    }
+
+    F.put_state(x,sidx);
+    for (size_t d = 0; d < NDEME; d++) x[sidx[nvar+d]] = F.ell[d+1];
+    node = parent;
+  };
+
+  //! Measurement model likelihood (dmeasure component).
+  static void pomp_dmeas
+  (
+   double *lik, const double *x, const int *sidx, int give_log
+   ) {
+    double ll = x[sidx[nvar+NDEME]];
+    assert(!ISNAN(ll));
+    *lik = (give_log) ? ll : exp(ll);
+  };
+
+};
+
+#define PARAM_GET(X) params.X = p[pidx[m++]];
+#define STATE_GET(X) state.X = x[sidx[m++]];
+#define STATE_PUT(X) x[sidx[m++]] = state.X;
+#define RATE_CALC(X) total += rate[m++] = (X);
+
+#endif
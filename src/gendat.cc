@@ -1,8 +1,72 @@
 // gendat: genealogy information extraction
 
 #include "genealogy.h"
+#include "genview.h"
+#include "cache.h"
 #include "internal.h"
 
+//! interval compression:
+//! simultaneous nodes are placed in a single group,
+//! so that they are processed in a single filter step.
+//! groups are numbered consecutively from 0.
+static void
+node_groups
+(const double *tout, int *group, size_t n) {
+  int g = 0;
+  for (size_t k = 0; k < n; k++) {
+    if (k > 0 && tout[k] > tout[k-1]) g++;
+    group[k] = g;
+  }
+}
+
+//! genealogy information in list format
+template <class TYPE>
+static SEXP
+gendat_list
+(const TYPE& G) {
+  SEXP t0, tout, group, anc, lin, sat, type, deme, index, child, ns, nr, nn;
+  SEXP out, outn;
+  size_t n = G.length();
+  PROTECT(t0 = NEW_NUMERIC(1));
+  PROTECT(tout = NEW_NUMERIC(n+1));
+  PROTECT(group = NEW_INTEGER(n));
+  PROTECT(type = NEW_INTEGER(n));
+  PROTECT(deme = NEW_INTEGER(n));
+  PROTECT(lin = NEW_INTEGER(n));
+  PROTECT(sat = NEW_INTEGER(n));
+  PROTECT(index = NEW_INTEGER(n));
+  PROTECT(child = NEW_INTEGER(n));
+  PROTECT(anc = NEW_INTEGER(n));
+  PROTECT(ns = NEW_INTEGER(1));
+  PROTECT(nr = NEW_INTEGER(1));
+  PROTECT(nn = NEW_INTEGER(1));
+  PROTECT(out = NEW_LIST(13));
+  PROTECT(outn = NEW_CHARACTER(13));
+  set_list_elem(out,outn,t0,"t0",0);
+  set_list_elem(out,outn,tout,"nodetime",1);
+  set_list_elem(out,outn,group,"group",2);
+  set_list_elem(out,outn,type,"nodetype",3);
+  set_list_elem(out,outn,deme,"deme",4);
+  set_list_elem(out,outn,lin,"lineage",5);
+  set_list_elem(out,outn,sat,"saturation",6);
+  set_list_elem(out,outn,index,"index",7);
+  set_list_elem(out,outn,child,"child",8);
+  set_list_elem(out,outn,anc,"ancestor",9);
+  set_list_elem(out,outn,ns,"nsample",10);
+  set_list_elem(out,outn,nr,"nroot",11);
+  set_list_elem(out,outn,nn,"nnode",12);
+  SET_NAMES(out,outn);
+  G.gendat(REAL(tout),INTEGER(anc),INTEGER(lin),INTEGER(sat),
+           INTEGER(type),INTEGER(deme),INTEGER(index),INTEGER(child));
+  node_groups(REAL(tout),INTEGER(group),n);
+  *REAL(t0) = double(G.timezero()); // zero-time
+  *INTEGER(ns) = G.nsample();     // number of samples
+  *INTEGER(nr) = G.nroot();       // number of roots
+  *INTEGER(nn) = G.length();      // number of nodes
+  UNPROTECT(15);
+  return out;
+}
+
 //! genealogy information in list format
 void
 genealogy_t::gendat
@@ -54,59 +118,74 @@ genealogy_t::gendat
   }
 }
 
+//! genealogy information in list format
+void
+genview_t::gendat
+(double *tout, int *anc, int *lin,
+ int *sat, int *type, int *deme,
+ int *index, int *child) const {
+  std::vector<size_t> first, kid, pos(_par.size());
+  children(first,kid);
+  int n, k;
+  for (n = 0; n < int(_seq.size()); n++) pos[_seq[n]] = n;
+  for (k = 0, n = 0; n < int(_seq.size()); n++) {
+    size_t s = _seq[n];
+    assert(_nblack[s] == 0);    // tree should be pruned first
+    tout[n] = _slate[s];
+    deme[n] = _deme[s];
+    if (is_root(s)) {
+      type[n] = 0;              // root node
+    } else if (_nblue[s] > 0) {
+      type[n] = 1;              // sample node
+      deme[n] = blue_deme(s);
+    } else {
+      type[n] = 2;              // internal node
+    }
+    lin[n] = _lin[s];           // 0-based indexing
+    sat[n] = nchildren(s);
+    index[n] = k;
+    k += sat[n];
+    child[n] = NA_INTEGER;
+    anc[n] = pos[_par[s]];      // 0-based indexing
+  }
+  tout[n] = time();
+  for (k = 0, n = 0; n < int(_seq.size()); n++) {
+    size_t s = _seq[n];
+    for (size_t j = first[s]; j < first[s+1]; j++) {
+      child[k++] = pos[kid[j]];
+    }
+  }
+}
+
 //! genealogy information in list format
 SEXP
 genealogy_t::gendat
 (void) const {
-  SEXP t0, tout, anc, lin, sat, type, deme, index, child, ns, nr, nn;
-  SEXP out, outn;
-  size_t n = length();
-  PROTECT(t0 = NEW_NUMERIC(1));
-  PROTECT(tout = NEW_NUMERIC(n+1));
-  PROTECT(type = NEW_INTEGER(n));
-  PROTECT(deme = NEW_INTEGER(n));
-  PROTECT(lin = NEW_INTEGER(n));
-  PROTECT(sat = NEW_INTEGER(n));
-  PROTECT(index = NEW_INTEGER(n));
-  PROTECT(child = NEW_INTEGER(n));
-  PROTECT(anc = NEW_INTEGER(n));
-  PROTECT(ns = NEW_INTEGER(1));
-  PROTECT(nr = NEW_INTEGER(1));
-  PROTECT(nn = NEW_INTEGER(1));
-  PROTECT(out = NEW_LIST(12));
-  PROTECT(outn = NEW_CHARACTER(12));
-  set_list_elem(out,outn,t0,"t0",0);
-  set_list_elem(out,outn,tout,"nodetime",1);
-  set_list_elem(out,outn,type,"nodetype",2);
-  set_list_elem(out,outn,deme,"deme",3);
-  set_list_elem(out,outn,lin,"lineage",4);
-  set_list_elem(out,outn,sat,"saturation",5);
-  set_list_elem(out,outn,index,"index",6);
-  set_list_elem(out,outn,child,"child",7);
-  set_list_elem(out,outn,anc,"ancestor",8);
-  set_list_elem(out,outn,ns,"nsample",9);
-  set_list_elem(out,outn,nr,"nroot",10);
-  set_list_elem(out,outn,nn,"nnode",11);
-  SET_NAMES(out,outn);
-  gendat(REAL(tout),INTEGER(anc),INTEGER(lin),INTEGER(sat),
-         INTEGER(type),INTEGER(deme),INTEGER(index),INTEGER(child));
-  *REAL(t0) = double(timezero()); // zero-time
-  *INTEGER(ns) = nsample();       // number of samples
-  *INTEGER(nr) = nroot();         // number of roots
-  *INTEGER(nn) = length();        // number of nodes
-  UNPROTECT(14);
-  return out;
+  return gendat_list(*this);
+}
+
+//! genealogy information in list format
+SEXP
+genview_t::gendat
+(void) const {
+  return gendat_list(*this);
 }
 
 extern "C" {
 
-  //! data-frame format
+  //! data-frame format.
+  //! a genealogy already in the cache is reused;
+  //! otherwise, the serialization is read in place where possible.
   SEXP gendat (SEXP State, SEXP Obscure) {
-    genealogy_t A = State;
-    A.prune();
-    if (*LOGICAL(Obscure)) A.obscure();
-    A.trace_lineages();
-    return A.gendat();
+    int how = pre_prune | (*LOGICAL(Obscure) ? pre_obscure : 0);
+    gencache_t& cache = genealogy_cache();
+    const genealogy_t *G = cache.find(State,how);
+    if (G != 0) return G->gendat();
+    if (genview_t::readable(State)) {
+      genview_t V = State;
+      if (V.sorted()) return preprocess(V,how).gendat();
+    }
+    return cache.fetch(State,how)->gendat();
   }
 
 }
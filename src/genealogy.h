@@ -19,6 +19,8 @@ static const size_t MEMORY_MAX = (1<<28); // 256MB
 //! and the current time.
 class genealogy_t : public nodeseq_t {
 
+  friend class genview_t;
+
 private:
 
   // GENEALOGY member data:
@@ -36,7 +38,12 @@ private:
   //! The number of demes (excluding the undeme).
   size_t _ndeme;
 
+  //! Signature of the legacy (fixed-width, native-endian) serialization.
   const static name_t magic = 1123581321;
+  //! Header of the compact serialization:
+  //! two signature bytes, the format version, and the byte order
+  //! ('L': multi-byte quantities are written least-significant byte first).
+  static constexpr raw_t header[4] = {'P','G',3,'L'};
 
 private:
 
@@ -70,28 +77,43 @@ public:
   // SERIALIZATION
   //! size of serialized binary form
   size_t bytesize (void) const {
-    return 3*sizeof(name_t) +
-      2*sizeof(slate_t) + nodeseq_t::bytesize();
+    return sizeof(header) + varint_size(_unique) + varint_size(_ndeme)
+      + slate_size(_t0,0) + slate_size(_time,_t0)
+      + nodeseq_t::bytesize();
   };
   //! binary serialization
   friend raw_t* operator>> (const genealogy_t& G, raw_t* o) {
-    name_t A[3]; A[0] = magic; A[1] = G._unique; A[2] = name_t(G.ndeme());
-    slate_t B[2]; B[0] = G.timezero(); B[1] = G.time();
-    memcpy(o,A,sizeof(A)); o += sizeof(A);
-    memcpy(o,B,sizeof(B)); o += sizeof(B);
+    memcpy(o,header,sizeof(header)); o += sizeof(header);
+    o = put_varint(o,G._unique);
+    o = put_varint(o,G._ndeme);
+    o = put_slate(o,G._t0,0);
+    o = put_slate(o,G._time,G._t0);
     return reinterpret_cast<const nodeseq_t&>(G) >> o;
   };
-  //! binary deserialization
+  //! binary deserialization.
+  //! the legacy format is recognized and read transparently.
   friend raw_t* operator>> (raw_t* o, genealogy_t& G) {
     G.clean();
     name_t A[3];
-    slate_t B[2];
-    memcpy(A,o,sizeof(A)); o += sizeof(A);
-    memcpy(B,o,sizeof(B)); o += sizeof(B);
-    if (A[0] != magic)
+    memcpy(A,o,sizeof(name_t));
+    if (A[0] == magic) {
+      slate_t B[2];
+      memcpy(A,o,sizeof(A)); o += sizeof(A);
+      memcpy(B,o,sizeof(B)); o += sizeof(B);
+      G._unique = A[1]; G.ndeme() = size_t(A[2]);
+      G.timezero() = B[0]; G.time() = B[1];
+      return legacy(o,reinterpret_cast<nodeseq_t&>(G));
+    }
+    if (o[0] != header[0] || o[1] != header[1] || o[3] != header[3])
       err("in %s: corrupted genealogy serialization.",__func__);
-    G._unique = A[1]; G.ndeme() = size_t(A[2]);
-    G.timezero() = B[0]; G.time() = B[1];
+    if (o[2] != header[2])
+      err("in %s: unsupported genealogy serialization version (%d).",
+          __func__,int(o[2]));
+    o += sizeof(header);
+    o = get_varint(o,G._unique);
+    o = get_varint(o,G._ndeme);
+    o = get_slate(o,G._t0,0);
+    o = get_slate(o,G._time,G._t0);
     return o >> reinterpret_cast<nodeseq_t&>(G);
   };
 
@@ -172,6 +194,10 @@ public:
                       int *ell, int *sat, int *etype) const;
   //! lineage count and saturation
   SEXP lineage_count (void) const;
+  //! lineage count at each of the times in 'grid', which must be
+  //! in increasing order, as by lineage_count, above:
+  //! ell[d+(ndeme+1)*k] is the number of lineages in deme d at grid[k].
+  void lineage_count (const std::vector<slate_t>& grid, int *ell) const;
 
   //! genealogy information in list format
   void gendat (double *tout, int *anc, int *lin,
@@ -189,6 +215,20 @@ public:
     return n;
   };
 
+  //! number of samples in each deme:
+  //! n[d] is the number of samples in deme d.
+  void nsample (std::vector<size_t>& n) const {
+    n.assign(ndeme()+1,0);
+    for (const node_t *p : *this) {
+      for (const ball_t *b : *p) {
+        if (b->is(blue)) {
+          if (b->deme() >= n.size()) n.resize(b->deme()+1,0);
+          n[b->deme()]++;
+        }
+      }
+    }
+  };
+
   //! number of roots
   size_t nroot (void) const {
     size_t n = 0;
@@ -307,40 +347,122 @@ public:
     add(p,a);
     a->deme() = d;
   };
-  //! prune the tree (drop all black balls)
+  //! prune the tree (drop all black balls).
+  //! a node is dropped if its descendants include a black ball
+  //! but no blue ball.
+  //! this is done in a single backward pass, in which each node is
+  //! visited after all of its descendants.
+  //! a black ball stands in for each dropped node in its parent's pocket.
   genealogy_t& prune (void) {
-    pocket_t *blacks = colored(black);
-    while (!blacks->empty()) {
-      ball_t *b = *(blacks->begin());
-      blacks->erase(b);
-      drop(b);
+    node_nit j = end();
+    while (j != begin()) {
+      node_t *p = *(--j);
+      ball_t *a = 0;
+      while (!p->empty() && p->last_ball()->is(black)) {
+        ball_t *b = p->last_ball();
+        p->erase(b);
+        if (a == 0) a = b;
+        else delete b;
+      }
+      if (a == 0) continue;
+      if (p->size() > (p->is_root() ? 1 : 0)) {
+        delete a;
+      } else {
+        p->insert(a);
+        swap(a,p->green_ball());
+        j = erase(j);
+        delete p;
+      }
     }
-    delete blacks;
     return *this;
   };
-  //! erase all deme information
+  //! erase all deme information.
+  //! drop superfluous nodes (holding just one ball) and dead roots.
+  //! this is done in a single forward pass:
+  //! each superfluous node hands its one ball to its parent,
+  //! whereupon it becomes a dead root.
   genealogy_t& obscure (void) {
-    // erase deme information from black balls.
-    pocket_t *blacks = colored(black);
-    while (!blacks->empty()) {
-      ball_t *a = *(blacks->begin());
-      a->deme() = undeme;
-      blacks->erase(a);
-    }
-    delete blacks;
-    // erase deme information from nodes.
-    for (node_t *p : *this) {
+    node_nit j = begin();
+    while (j != end()) {
+      node_t *p = *j;
+      for (ball_t *b : *p) {
+        if (b->is(black)) b->deme() = undeme;
+      }
       p->deme() = undeme;
+      if (p->size() == 1 && p->holds(green)) {
+        swap(p->last_ball(),p->green_ball());
+      }
+      if (p->dead_root()) {
+        j = erase(j);
+        delete p;
+      } else {
+        j++;
+      }
     }
-    // drop superfluous nodes (holding just one ball).
-    comb();
     ndeme() = 0;
     return *this;
   };
+  //! drop the samples not marked in 'keep'.
+  //! keep[k] refers to the k-th sample (blue ball), in order.
+  //! the genealogy is left as though the dropped samples had never been taken:
+  //! a node that thereby loses all its balls is dropped, along with
+  //! its branch, and one left holding a single ball (not a sample)
+  //! hands it to its parent.
+  //! this is done in a single backward pass, in which each node is
+  //! visited after all of its descendants.
+  //! the lineages are traced anew.
+  genealogy_t& thin (const std::vector<bool>& keep) {
+    size_t k = 0;
+    for (const node_t *p : *this) {
+      for (const ball_t *b : *p) {
+        if (b->is(blue)) k++;
+      }
+    }
+    if (k != keep.size())
+      err("in '%s': expecting %zu samples, not %zu.",__func__,k,keep.size());
+    node_nit j = end();
+    while (j != begin()) {
+      node_t *p = *(--j);
+      p->lineage() = null_lineage;
+      for (const ball_t *b : *p) {
+        if (b->is(blue)) k--;
+      }
+      size_t i = k;
+      bool thinned = false;
+      ball_it a = p->begin();
+      while (a != p->end()) {
+        ball_t *b = *a;
+        if (b->is(blue) && !keep[i++]) {
+          a = p->erase(a);
+          delete b;
+          thinned = true;
+        } else {
+          a++;
+        }
+      }
+      if (p->is_root()) {
+        if (!p->dead_root()) continue;
+      } else if (p->empty()) {
+        detach(p);
+      } else if (thinned && p->size() == 1 && !p->holds(blue)) {
+        swap(p->last_ball(),p->green_ball());
+      } else {
+        continue;
+      }
+      j = erase(j);
+      delete p;
+    }
+    trace_lineages();
+    return *this;
+  };
 
   //! curtail the genealogy by removing nodes
   //! with times later than tnew and/or earlier than troot
   void curtail (slate_t tnew, slate_t troot);
+  //! W := the genealogy as curtailed to [troot, tnew],
+  //! built from the nodes within the window alone;
+  //! this genealogy is neither copied nor altered.
+  void window (slate_t tnew, slate_t troot, genealogy_t& W) const;
 
 private:
 
@@ -354,10 +476,17 @@ public:
   //! 3. the current time retreats as necessary;
   //! 4. the unique-name stack advances as necessary.
   genealogy_t& operator+= (const genealogy_t& other);
+  //! merge several genealogies at once, with the same result as
+  //! adding them in turn. their nodes are moved, not copied,
+  //! so that the genealogies are left empty.
+  genealogy_t& absorb (std::vector<genealogy_t>& parts);
 
-  //! insert zero-length branches for samples where needed
+  //! insert zero-length branches for samples where needed.
+  //! each new node is placed in order just after its parent.
   genealogy_t& insert_zlb (void) {
-    for (node_t *p : *this) {
+    reorder();
+    for (node_nit j = begin(); j != end(); j++) {
+      node_t *p = *j;
       if (p->holds(green) && p->holds(blue)) {
         assert(!p->holds(black)); // genealogy should have already been pruned
         ball_t *b = p->last_ball();
@@ -365,10 +494,9 @@ public:
         node_t *q = make_node(p->deme());
         q->slate = p->slate;
         swap(q->green_ball(),b);
-        push_back(q);
+        place(q,std::next(j));
       }
     }
-    sort();
     return *this;
   };
 
@@ -380,17 +508,17 @@ private:
   void cap_tips (void);
   //! roots are added at zero time if needed
   void cap_roots (void) {
+    reorder();
     node_nit j = begin();
     while (j != end()) {
       if ((*j)->is_root() && (*j)->slate > timezero()) {
         node_t *q = make_node();
         q->slate = timezero();
         attach(q,*j);
-        push_front(q);
+        place(q,begin());
       }
       j++;
     }
-    sort();
   };
 
   //! Scan the branch-label string.
@@ -411,18 +539,20 @@ public:
   };
 
   //! return the CBLV representation as an R matrix
-  friend SEXP cblv (genealogy_t&);
+  friend SEXP cblv (const genealogy_t&);
 
   //! parse a CBLV representation in the vectors x and y.
   genealogy_t& parse_cblv (const double *, const double *, int, double);
 
-private:
-
   //! return the CBLV representation in the vectors x and y:
   //! - x[i] = branch length added by the i-th sample leaf
   //! - y[i] = height above t0 of the i-th internal branching event
   std::pair<std::vector<slate_t>, std::vector<slate_t>> cblv (void) const;
 
+  //! return the representation as a 'phylo' object (package 'ape'),
+  //! with the deme and type of each node.
+  SEXP phylo (void) const;
+
 };
 
 #endif
@@ -0,0 +1,442 @@
+// -*- C++ -*-
+// GENVIEW class
+
+#ifndef _GENVIEW_H_
+#define _GENVIEW_H_
+
+#include <vector>
+#include <algorithm>
+
+#include "genealogy.h"
+#include "internal.h"
+
+//! A read-only view of a serialized genealogy.
+
+//! The view interprets the compact serialization in place:
+//! a single pass over the buffer builds an index holding,
+//! for each node, the offset of its balls in the buffer
+//! together with a few flat columns (name, time, parent, etc.).
+//! Read-only queries therefore require no per-node allocation.
+//! Pruning, obscuring, and the insertion of zero-length branches
+//! are emulated on the index, with the same results as the
+//! corresponding operations on a deserialized genealogy_t.
+class genview_t {
+
+private:
+
+  //! The serialized genealogy.
+  raw_t *_buf;
+  //! Length of the serialized genealogy.
+  size_t _size;
+  //! The next unique name.
+  name_t _unique;
+  //! The initial time.
+  slate_t _t0;
+  //! The current time.
+  slate_t _time;
+  //! The number of demes (excluding the undeme).
+  size_t _ndeme;
+  //! Does every node follow its parent in the sequence?
+  bool _sorted;
+  //! Have black balls been dropped?
+  bool _pruned;
+  //! Have demes been erased?
+  bool _obscured;
+
+  // NODE INDEX
+  // One entry per node.
+  // Entries beyond those of the buffer are nodes
+  // created by insert_zlb.
+
+  //! offset of the node's first blue or black ball
+  std::vector<size_t> _off;
+  //! name of the node
+  std::vector<name_t> _uniq;
+  //! time of the node
+  std::vector<slate_t> _slate;
+  //! index entry of the parent (the node itself for roots)
+  std::vector<size_t> _par;
+  //! lineage
+  std::vector<name_t> _lin;
+  //! deme
+  std::vector<name_t> _deme;
+  //! number of blue balls held
+  std::vector<int> _nblue;
+  //! number of black balls held
+  std::vector<int> _nblack;
+  //! number of child nodes
+  std::vector<int> _nkid;
+  //! index entries in sequence order
+  std::vector<size_t> _seq;
+
+private:
+
+  //! read a serialized ball
+  static raw_t* get_ball (raw_t *o, color_t &col, name_t &d) {
+    name_t u;
+    o = get_varint(o,u);
+    o = get_varint(o,d);
+    col = color_t(u & 3);
+    return o;
+  };
+  //! deme of the k-th non-green ball of node s
+  name_t ball_deme (size_t s, int k) const {
+    raw_t *o = _buf+_off[s];
+    color_t col;
+    name_t d = undeme;
+    for (int j = 0; j <= k; j++) o = get_ball(o,col,d);
+    return d;
+  };
+
+  //! count the children of each node
+  void count_kids (void) {
+    for (size_t s : _seq) _nkid[s] = 0;
+    for (size_t s : _seq) {
+      if (!is_root(s)) _nkid[_par[s]]++;
+    }
+  };
+
+public:
+
+  //! can the view read this object?
+  //! the view understands the current serialization only.
+  static bool readable (SEXP o) {
+    const raw_t *h = genealogy_t::header;
+    if (TYPEOF(o) != RAWSXP || XLENGTH(o) < R_xlen_t(sizeof(genealogy_t::header)))
+      return false;
+    const raw_t *b = RAW(o);
+    return (b[0] == h[0] && b[1] == h[1] && b[2] == h[2] && b[3] == h[3]);
+  };
+
+  // CONSTRUCTORS
+  //! constructor from RAW SEXP (containing binary serialization).
+  //! the SEXP must remain protected for the lifetime of the view.
+  genview_t (SEXP o) {
+    if (!readable(o))
+      err("in %s: cannot view this genealogy serialization.",__func__);
+    _buf = RAW(o);
+    _sorted = true;
+    _pruned = _obscured = false;
+    raw_t *p = _buf+sizeof(genealogy_t::header);
+    p = get_varint(p,_unique);
+    p = get_varint(p,_ndeme);
+    p = get_slate(p,_t0,0);
+    p = get_slate(p,_time,_t0);
+    size_t nnode;
+    p = get_varint(p,nnode);
+    _off.resize(nnode); _uniq.resize(nnode); _slate.resize(nnode);
+    _par.resize(nnode); _lin.resize(nnode); _deme.resize(nnode);
+    _nblue.assign(nnode,0); _nblack.assign(nnode,0); _nkid.assign(nnode,0);
+    _seq.resize(nnode);
+    slate_t t = 0;
+    for (size_t i = 0; i < nnode; i++) {
+      uint64_t z;
+      name_t lc;
+      size_t nball;
+      p = get_slate(p,_slate[i],t);
+      t = _slate[i];
+      p = get_varint(p,z);
+      int64_t j = int64_t(i) + unzigzag(z);
+      if (j < 0 || j >= int64_t(nnode))
+        err("in %s: corrupted genealogy serialization.",__func__); // #nocov
+      _par[i] = size_t(j);
+      _sorted = _sorted && (_par[i] <= i);
+      p = get_varint(p,_uniq[i]);
+      p = get_varint(p,lc);
+      p = get_varint(p,_deme[i]);
+      p = get_varint(p,nball);
+      _lin[i] = (lc == 0) ? null_lineage : lc-1;
+      _off[i] = p-_buf;
+      for (size_t k = 0; k < nball; k++) {
+        color_t col;
+        name_t d;
+        p = get_ball(p,col,d);
+        switch (col) {
+        case blue:
+          _nblue[i]++;
+          break;
+        case black:
+          _nblack[i]++;
+          break;
+        default:
+          err("in %s: corrupted genealogy serialization.",__func__); // #nocov
+          break;
+        }
+      }
+      _seq[i] = i;
+    }
+    _size = p-_buf;
+    count_kids();
+    trace_lineages();
+  };
+
+public:
+
+  //! length of the serialized genealogy.
+  //! this may be less than that of the buffer,
+  //! which may hold the state of a process following the genealogy.
+  size_t bytesize (void) const {
+    return _size;
+  };
+  //! is the view usable?
+  //! the emulated operations need each parent to precede its children.
+  bool sorted (void) const {
+    return _sorted;
+  };
+  //! number of demes
+  size_t ndeme (void) const {
+    return _ndeme;
+  };
+  //! view current time.
+  slate_t time (void) const {
+    return _time;
+  };
+  //! view zero time.
+  slate_t timezero (void) const {
+    return _t0;
+  };
+  //! number of nodes
+  size_t length (void) const {
+    return _seq.size();
+  };
+  //! is node s a root?
+  bool is_root (size_t s) const {
+    return _par[s] == s;
+  };
+  //! number of descendants of node s
+  int nchildren (size_t s) const {
+    return _nkid[s] + _nblack[s];
+  };
+  //! deme of the (last) blue ball of node s
+  name_t blue_deme (size_t s) const {
+    return ball_deme(s,_nblue[s]-1);
+  };
+  //! deme of the k-th black ball of node s
+  name_t black_deme (size_t s, int k) const {
+    return (_obscured) ? undeme : ball_deme(s,_nblue[s]+k);
+  };
+
+  //! number of samples
+  size_t nsample (void) const {
+    size_t n = 0;
+    for (size_t s : _seq) {
+      if (_nblue[s] > 0) n++;
+    }
+    return n;
+  };
+  //! number of samples in each deme. see genealogy_t::nsample.
+  void nsample (std::vector<size_t>& n) const {
+    n.assign(_ndeme+1,0);
+    for (size_t s : _seq) {
+      raw_t *o = _buf+_off[s];
+      for (int k = 0; k < _nblue[s]; k++) {
+        color_t col;
+        name_t d;
+        o = get_ball(o,col,d);
+        if (d >= n.size()) n.resize(d+1,0);
+        n[d]++;
+      }
+    }
+  };
+  //! number of roots
+  size_t nroot (void) const {
+    size_t n = 0;
+    for (size_t s : _seq) {
+      if (is_root(s)) n++;
+    }
+    return n;
+  };
+  //! number of distinct timepoints
+  size_t ntime (slate_t t) const {
+    size_t count = 1;
+    for (size_t s : _seq) {
+      if (t < _slate[s]) {
+        t = _slate[s];
+        count++;
+      }
+    }
+    return count;
+  };
+
+public:
+
+  //! prune the tree (drop all black balls).
+  //! a node is removed if its descendants include a black ball
+  //! but no blue ball.
+  genview_t& prune (void) {
+    std::vector<char> hasblue(_par.size(),0), hasblack(_par.size(),0);
+    for (auto i = _seq.rbegin(); i != _seq.rend(); i++) {
+      size_t s = *i;
+      hasblue[s] |= (_nblue[s] > 0);
+      hasblack[s] |= (_nblack[s] > 0);
+      if (!is_root(s)) {
+        hasblue[_par[s]] |= hasblue[s];
+        hasblack[_par[s]] |= hasblack[s];
+      }
+    }
+    size_t n = 0;
+    for (size_t s : _seq) {
+      _nblack[s] = 0;
+      if (hasblue[s] || !hasblack[s]) _seq[n++] = s;
+    }
+    _seq.resize(n);
+    count_kids();
+    _pruned = true;
+    return *this;
+  };
+  //! erase all deme information.
+  //! drop superfluous nodes (holding just one ball) and dead roots.
+  genview_t& obscure (void) {
+    std::vector<char> gone(_par.size(),0);
+    for (size_t s : _seq) {
+      _deme[s] = undeme;
+      if (gone[_par[s]]) _par[s] = _par[_par[s]];
+      gone[s] = !is_root(s) && _nkid[s] == 1 &&
+        _nblue[s] == 0 && _nblack[s] == 0;
+    }
+    size_t n = 0;
+    for (size_t s : _seq) {
+      bool dead = is_root(s) && _nkid[s] == 0 &&
+        _nblue[s] == 0 && _nblack[s] == 0;
+      if (!gone[s] && !dead) _seq[n++] = s;
+    }
+    _seq.resize(n);
+    _ndeme = 0;
+    _obscured = true;
+    return *this;
+  };
+  //! trace back all sample lineages
+  genview_t& trace_lineages (void) {
+    name_t u = 0;
+    for (size_t s : _seq) {
+      for (int k = 0; k < _nblue[s]; k++, u++) {
+        size_t p = s;
+        while (_lin[p] == null_lineage) {
+          _lin[p] = u;
+          p = _par[p];
+        }
+      }
+    }
+    return *this;
+  };
+  //! insert zero-length branches for samples where needed.
+  //! each new node takes the last blue ball of its parent.
+  genview_t& insert_zlb (void) {
+    if (!_pruned)
+      err("in %s: genealogy should have already been pruned.",__func__); // #nocov
+    size_t n = _seq.size();
+    for (size_t k = 0; k < n; k++) {
+      size_t s = _seq[k];
+      if ((is_root(s) || _nkid[s] > 0) && _nblue[s] > 0) {
+        size_t q = _par.size();
+        _nblue[s]--;
+        _nkid[s]++;
+        raw_t *o = _buf+_off[s];
+        for (int j = 0; j < _nblue[s]; j++) {
+          color_t col;
+          name_t d;
+          o = get_ball(o,col,d);
+        }
+        _off.push_back(o-_buf);
+        _uniq.push_back(_unique++);
+        _slate.push_back(_slate[s]);
+        _par.push_back(s);
+        _lin.push_back(null_lineage);
+        _deme.push_back(_deme[s]);
+        _nblue.push_back(1);
+        _nblack.push_back(0);
+        _nkid.push_back(0);
+        _seq.push_back(q);
+      }
+    }
+    // as nodeseq_t::compare
+    auto depth = [this](size_t p) {
+      size_t d = 0;
+      while (!is_root(p) && _slate[_par[p]] == _slate[p]) {
+        p = _par[p];
+        d++;
+      }
+      return d;
+    };
+    std::stable_sort(_seq.begin(),_seq.end(),
+                     [this,&depth](size_t p, size_t q) {
+                       if (_slate[p] < _slate[q]) return true;
+                       if (_slate[q] < _slate[p]) return false;
+                       size_t dp = depth(p), dq = depth(q);
+                       return (dp < dq) || ((dp == dq) && (_uniq[p] < _uniq[q]));
+                     });
+    return *this;
+  };
+
+public:
+
+  //! lineage count, saturation, and event-type.
+  //! see genealogy_t::lineage_count.
+  void lineage_count (double *tout, int *deme,
+                      int *ell, int *sat, int *etype) const;
+  //! lineage count and saturation
+  SEXP lineage_count (void) const;
+  //! lineage count on a grid of times.
+  //! see genealogy_t::lineage_count.
+  void lineage_count (const std::vector<slate_t>& grid, int *ell) const;
+
+  //! genealogy information in list format
+  void gendat (double *tout, int *anc, int *lin,
+               int *sat, int *type, int *deme,
+               int *index, int *child) const;
+  //! genealogy information in list format
+  SEXP gendat (void) const;
+
+  //! put genealogy at current time into Newick format.
+  string_t newick (bool extended = true) const;
+
+  //! dense form of the tree, with nodes numbered by position in the
+  //! sequence. see nodeseq_t::dense.
+  void dense (std::vector<size_t>& par, std::vector<slate_t>& tm) const {
+    std::vector<size_t> pos(_par.size());
+    for (size_t i = 0; i < _seq.size(); i++) pos[_seq[i]] = i;
+    par.resize(_seq.size()); tm.resize(_seq.size());
+    for (size_t i = 0; i < _seq.size(); i++) {
+      par[i] = pos[_par[_seq[i]]];
+      tm[i] = _slate[_seq[i]];
+    }
+  };
+  //! dense form, with the number of samples held by each node.
+  //! see nodeseq_t::dense.
+  void dense (std::vector<size_t>& par, std::vector<slate_t>& tm,
+              std::vector<int>& nblue) const {
+    dense(par,tm);
+    nblue.resize(_seq.size());
+    for (size_t i = 0; i < _seq.size(); i++) nblue[i] = _nblue[_seq[i]];
+  };
+  //! CBLV representation. see genealogy_t::cblv.
+  std::pair<std::vector<slate_t>, std::vector<slate_t>> cblv (void) const;
+  //! 'phylo' representation. see genealogy_t::phylo.
+  SEXP phylo (void) const;
+
+private:
+
+  //! children of each node, as index entries, in sequence order:
+  //! those of node s are kid[first[s]], ..., kid[first[s+1]-1].
+  void children (std::vector<size_t>& first, std::vector<size_t>& kid) const {
+    first.assign(_par.size()+1,0);
+    kid.resize(_seq.size());
+    for (size_t s : _seq) {
+      if (!is_root(s)) first[_par[s]+1]++;
+    }
+    for (size_t s = 0; s < _par.size(); s++) first[s+1] += first[s];
+    std::vector<size_t> fill(first.begin(),first.end()-1);
+    for (size_t s : _seq) {
+      if (!is_root(s)) kid[fill[_par[s]]++] = s;
+    }
+  };
+
+  //! Newick format for the subtree rooted at node s
+  string_t newick (size_t s, const std::vector<size_t>& first,
+                   const std::vector<size_t>& kid,
+                   const slate_t& tnow, const slate_t& tpar,
+                   bool showdeme, bool extended) const;
+
+};
+
+#endif
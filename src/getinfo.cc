@@ -1,8 +1,11 @@
 // Get information about a genealogy
 
 #include "genealogy.h"
+#include "cache.h"
+#include "genview.h"
 #include "generics.h"
 #include "internal.h"
+#include <type_traits>
 
 static size_t matchargs (const char *prov, const char **set, size_t n) {
   size_t i;
@@ -12,6 +15,70 @@ static size_t matchargs (const char *prov, const char **set, size_t n) {
   return i;
 }
 
+//! assemble the requested information.
+//! flags are as in 'getInfo', less the object and the preprocessing.
+//! A has already been preprocessed accordingly.
+template <class TYPE>
+static SEXP report (const TYPE& A, const bool *f, bool extended,
+                    size_t nout, SEXP object) {
+  int k;
+  SEXP out, outnames;
+  PROTECT(out = NEW_LIST(nout));
+  PROTECT(outnames = NEW_CHARACTER(nout));
+  k = 0;
+  if (*(f++)) {               // t0
+    k = set_list_elem(out,outnames,timezero(A),"t0",k);
+  }
+  if (*(f++)) {               // time
+    k = set_list_elem(out,outnames,time(A),"time",k);
+  }
+  if (*(f++)) {               // nsample
+    k = set_list_elem(out,outnames,nsample(A),"nsample",k);
+  }
+  if (*(f++)) {               // nroot
+    k = set_list_elem(out,outnames,nroot(A),"nroot",k);
+  }
+  if (*(f++)) {               // ndeme
+    k = set_list_elem(out,outnames,ndeme(A),"ndeme",k);
+  }
+  if constexpr (std::is_same<TYPE,genealogy_t>::value) {
+    if (*(f++)) {             // structure
+      k = set_list_elem(out,outnames,structure(A),"structure",k);
+    }
+    if (*(f++)) {             // yaml
+      k = set_list_elem(out,outnames,yaml(A),"yaml",k);
+    }
+  } else {
+    f += 2;
+  }
+  if (*(f++)) {               // newick
+    k = set_list_elem(out,outnames,newick(A,extended),"newick",k);
+  }
+  if (*(f++)) {               // lineages
+    k = set_list_elem(out,outnames,lineage_count(A),"lineages",k);
+  }
+  if (*(f++)) {               // gendat
+    k = set_list_elem(out,outnames,gendat(A),"gendat",k);
+  }
+  if constexpr (std::is_same<TYPE,genealogy_t>::value) {
+    if (*(f++)) {             // genealogy
+      SEXP S;
+      PROTECT(S = serial(A));
+      SET_ATTR(S,install("class"),mkString("gpgen"));
+      k = set_list_elem(out,outnames,S,"genealogy",k);
+      UNPROTECT(1);
+    }
+    if (*(f++)) {             // cblv
+      const genealogy_t *G =
+        genealogy_cache().fetch(object,pre_prune|pre_obscure|pre_zlb);
+      k = set_list_elem(out,outnames,cblv(*G),"cblv",k);
+    }
+  }
+  SET_NAMES(out,outnames);
+  UNPROTECT(2);
+  return out;
+}
+
 extern "C" {
 
   //! extract requested information
@@ -48,66 +115,34 @@ extern "C" {
     }
 
     if (!flag[0]) err("no genealogy furnished to '%s'",__func__);
-    genealogy_t A = object;
 
-    // prune and/or obscure if requested
-    const bool *f = flag+1;
-    if (*(f++)) A.prune();
-    if (*(f++)) A.obscure();
-    A.trace_lineages();
-    bool extended = false;
-    if (*(f++)) {
-      extended = true;
-    } else {
-      A.insert_zlb();
-    }
+    // preprocessing: prune and/or obscure if requested;
+    // insert zero-length branches unless the extended format is wanted.
+    bool extended = flag[3];
+    int how = (flag[1] ? pre_prune : 0) | (flag[2] ? pre_obscure : 0) |
+      (extended ? 0 : pre_zlb);
 
-    SEXP out, outnames;
-    PROTECT(out = NEW_LIST(nout));
-    PROTECT(outnames = NEW_CHARACTER(nout));
-    k = 0;
-    if (*(f++)) {               // t0
-      k = set_list_elem(out,outnames,timezero(A),"t0",k);
-    }
-    if (*(f++)) {               // time
-      k = set_list_elem(out,outnames,time(A),"time",k);
-    }
-    if (*(f++)) {               // nsample
-      k = set_list_elem(out,outnames,nsample(A),"nsample",k);
-    }
-    if (*(f++)) {               // nroot
-      k = set_list_elem(out,outnames,nroot(A),"nroot",k);
-    }
-    if (*(f++)) {               // ndeme
-      k = set_list_elem(out,outnames,ndeme(A),"ndeme",k);
-    }
-    if (*(f++)) {               // structure
-      k = set_list_elem(out,outnames,structure(A),"structure",k);
-    }
-    if (*(f++)) {               // yaml
-      k = set_list_elem(out,outnames,yaml(A),"yaml",k);
-    }
-    if (*(f++)) {               // newick
-      k = set_list_elem(out,outnames,newick(A,extended),"newick",k);
-    }
-    if (*(f++)) {               // lineages
-      k = set_list_elem(out,outnames,lineage_count(A),"lineages",k);
-    }
-    if (*(f++)) {               // gendat
-      k = set_list_elem(out,outnames,gendat(A),"gendat",k);
-    }
-    if (*(f++)) {               // genealogy
-      SEXP S;
-      PROTECT(S = serial(A));
-      SET_ATTR(S,install("class"),mkString("gpgen"));
-      k = set_list_elem(out,outnames,S,"genealogy",k);
-      UNPROTECT(1);
-    }
-    if (*(f++)) {               // cblv
-      k = set_list_elem(out,outnames,cblv(A),"cblv",k);
+    // a genealogy decoded and preprocessed by an earlier call is reused.
+    // otherwise, read the serialization in place, unless the requested
+    // information requires a full deserialization.
+    gencache_t& cache = genealogy_cache();
+    const genealogy_t *G = cache.find(object,how);
+    if (G == 0) {
+      bool full = flag[9] || flag[10] || flag[14] || flag[15];
+      if (!full && (flag[1] || flag[3]) && genview_t::readable(object)) {
+        genview_t V = object;
+        if (V.sorted())
+          return report(preprocess(V,how),flag+4,extended,nout,object);
+      }
+      G = cache.fetch(object,how);
     }
-    SET_NAMES(out,outnames);
-    UNPROTECT(2);
-    return out;
+    return report(*G,flag+4,extended,nout,object);
   }
+
+  //! empty the cache of decoded genealogies
+  SEXP clear_cache (void) {
+    genealogy_cache().clear();
+    return R_NilValue;
+  }
+
 }
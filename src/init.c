@@ -10,12 +10,30 @@ SEXP parse_newick (SEXP, SEXP, SEXP);
 SEXP getInfo (SEXP);
 SEXP genealSum (SEXP);
 SEXP curtail (SEXP, SEXP, SEXP);
+SEXP curtail_info (SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
 SEXP yaml (SEXP);
 SEXP gendat (SEXP, SEXP);
 SEXP geneal (SEXP);
 SEXP genealScaleShift (SEXP, SEXP, SEXP);
 SEXP cblv (SEXP);
+SEXP cblv_array (SEXP, SEXP, SEXP);
 SEXP parse_cblv (SEXP, SEXP, SEXP);
+SEXP storeOpen (SEXP);
+SEXP storeLength (SEXP);
+SEXP storeAppend (SEXP, SEXP);
+SEXP storeGet (SEXP, SEXP);
+SEXP treestats (SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP treedist (SEXP, SEXP, SEXP, SEXP);
+SEXP subsample (SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP lineages_grid (SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP phylo (SEXP, SEXP, SEXP);
+SEXP lbdp_exact_grid (SEXP, SEXP, SEXP);
+SEXP lbdp_exact_grad (SEXP, SEXP, SEXP);
+SEXP moran_exact (SEXP, SEXP, SEXP, SEXP);
+SEXP lbdp_exact_list (SEXP, SEXP, SEXP);
+SEXP moran_exact_list (SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP batch_pfilter (SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP clear_cache (void);
 
 // for each model, there must be
 // one DECLARATIONS line and one METHODS line.
@@ -50,12 +68,30 @@ static const R_CallMethodDef callMethods[] = {
   METHODS(TwoUndead),
   {"parse_newick", (DL_FUNC) &parse_newick, 3},
   {"curtail", (DL_FUNC) &curtail, 3},
+  {"curtail_info", (DL_FUNC) &curtail_info, 9},
   {"yaml", (DL_FUNC) &yaml, 1},
   {"gendat", (DL_FUNC) &gendat, 2},
   {"geneal", (DL_FUNC) &geneal, 1},
   {"geneal_scale", (DL_FUNC) &genealScaleShift, 3},
   {"cblv", (DL_FUNC) &cblv, 1},
+  {"cblv_array", (DL_FUNC) &cblv_array, 3},
   {"parse_cblv", (DL_FUNC) &parse_cblv, 3},
+  {"store_open", (DL_FUNC) &storeOpen, 1},
+  {"store_length", (DL_FUNC) &storeLength, 1},
+  {"store_append", (DL_FUNC) &storeAppend, 2},
+  {"store_get", (DL_FUNC) &storeGet, 2},
+  {"treestats", (DL_FUNC) &treestats, 5},
+  {"treedist", (DL_FUNC) &treedist, 4},
+  {"subsample", (DL_FUNC) &subsample, 5},
+  {"lineages_grid", (DL_FUNC) &lineages_grid, 5},
+  {"phylo", (DL_FUNC) &phylo, 3},
+  {"lbdp_exact_grid", (DL_FUNC) &lbdp_exact_grid, 3},
+  {"lbdp_exact_grad", (DL_FUNC) &lbdp_exact_grad, 3},
+  {"moran_exact", (DL_FUNC) &moran_exact, 4},
+  {"lbdp_exact_list", (DL_FUNC) &lbdp_exact_list, 3},
+  {"moran_exact_list", (DL_FUNC) &moran_exact_list, 5},
+  {"batch_pfilter", (DL_FUNC) &batch_pfilter, 5},
+  {"clear_cache", (DL_FUNC) &clear_cache, 0},
   {NULL, NULL, 0}
 };
 
@@ -94,4 +94,93 @@ static inline int rcateg (double erate, double *rate, int nrate) {
   return e;
 }
 
+// tau-leaping in the filter-equation kernels:
+// a leap is taken in place of exact steps only if at least
+// 'leap_min' events are expected in it,
+// and no compartment is expected to change by more than
+// a fraction 'leap_eps' of its free members (those that carry no lineage),
+// or by more than one member, whichever is larger.
+// cf. Cao, Gillespie, & Petzold (2006) J Chem Phys 124:044109.
+static const double leap_min = 10;
+static const double leap_eps = 0.03;
+
+// shorten the leap h, if need be, for a compartment with m free members,
+// entered at total rate 'in' and left at total rate 'out'.
+static inline double leap_bound (double h, double m, double in, double out) {
+  double b = (leap_eps*m > 1) ? leap_eps*m : 1;
+  double drift = fabs(in-out), var = in+out;
+  if (drift*h > b) h = b/drift;
+  if (var*h > b*b) h = b*b/var;
+  return h;
+}
+
+// number of events of a type, occurring at the given rate, in a leap of length h.
+static inline double leap_count (double rate, double h) {
+  return (rate > 0) ? rpois(rate*h) : 0;
+}
+
+// guided proposals in the filter-equation kernels:
+// where the next node requires its lineage to lie in a deme other than
+// the one it currently occupies, the move of that lineage into the
+// required deme is proposed at a rate of at least 'guide_n' per interval.
+// the excess over its rate under the filter equation is an extra event,
+// offset in the penalty, and each move of the lineage is weighted by the
+// ratio of the two rates, so that the weights remain unbiased.
+static const double guide_n = 3;
+
+// extra rate at which a lineage, moving at rate r,
+// is moved in an interval of length dt.
+// *dlog is set to the log weight of its move.
+// a lineage that cannot move (r = 0) is not guided.
+static inline double guide_rate (double r, double dt, double *dlog) {
+  double q = guide_n/dt - r;
+  if (r > 0 && q > 0) {
+    *dlog = log(r/(r+q));
+    return q;
+  } else {
+    *dlog = 0;
+    return 0;
+  }
+}
+
+// total rate of the events flagged in 'mask'.
+// their rates are copied into 'mrate', those of the others being set to zero.
+static inline double masked_rates
+(
+ const double *rate, const int *mask, double *mrate, int nrate
+ ) {
+  double r = 0;
+  for (int e = 0; e < nrate; e++)
+    r += (mrate[e] = (mask[e]) ? rate[e] : 0);
+  return r;
+}
+
+// uniformized (thinned) steps in the filter-equation kernels:
+// candidate events of each type are drawn at a bounding rate,
+// and accepted with probability equal to the ratio of the true rate to it.
+// only the rate of the candidate's type is evaluated.
+// the bounds hold until 'span' events have been accepted,
+// 'span' being chosen so that they exceed the total rate
+// by no more than a fraction 'thin_eps' of it.
+// cf. Lewis & Shedler (1979) Nav Res Logist Q 26:403.
+static const double thin_eps = 0.05;
+
+// number of events for which the bounds are kept,
+// where each event raises the bound on the total rate by at most 'slope'.
+static inline double thin_span (double rate, double slope) {
+  double k = (slope > 0) ? floor(thin_eps*rate/slope) : 0;
+  return (k > 1) ? k : 1;
+}
+
+// type of a candidate event, drawn from the bounding rates.
+// on return, *u is uniform on [0,bound[e]):
+// the candidate is accepted if *u is less than the true rate.
+static inline int thin_categ (double total, const double *bound, int n, double *u) {
+  double v = total*unif_rand();
+  int e = 0;
+  while (v >= bound[e] && e < n-1) v -= bound[e++];
+  *u = v;
+  return e;
+}
+
 #endif
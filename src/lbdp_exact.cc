@@ -0,0 +1,351 @@
+// Exact likelihood of the linear birth-death-sampling process
+// (Stadler 2010; King et al. 2024), evaluated at many parameter sets.
+
+#include "genealogy.h"
+#include "cache.h"
+#include "genview.h"
+#include "internal.h"
+#include <vector>
+
+//! The features of a (pruned, obscured) genealogy
+//! on which the exact likelihood depends.
+//! times are relative to the final time.
+typedef struct {
+  double t0;                    // root time
+  int nroot;                    // number of roots
+  int ninline;                  // number of inline samples
+  std::vector<double> tbr;      // coalescence times
+  std::vector<double> ttp;      // tip sample times
+} lbdp_data_t;
+
+//! extract the features of the genealogy G.
+template <class TYPE>
+static void
+lbdp_data
+(const TYPE& G, lbdp_data_t& D)
+{
+  size_t n = G.length();
+  std::vector<double> tout(n+1);
+  std::vector<int> anc(n), lin(n), sat(n), type(n), deme(n), index(n), child(n);
+  G.gendat(tout.data(),anc.data(),lin.data(),sat.data(),
+           type.data(),deme.data(),index.data(),child.data());
+  double tf = tout[n];
+  D.t0 = double(G.timezero())-tf;
+  D.nroot = int(G.nroot());
+  D.ninline = 0;
+  D.tbr.clear(); D.ttp.clear();
+  for (size_t i = 0; i < n; i++) {
+    if (type[i] == 2) {
+      D.tbr.push_back(tout[i]-tf);
+    } else if (type[i] == 1) {
+      if (sat[i] == 0) D.ttp.push_back(tout[i]-tf);
+      else if (sat[i] == 1) D.ninline++;
+    }
+  }
+  if (D.ttp.size() != D.tbr.size()+D.nroot)
+    err("in '%s': internal inconsistency in 'data'.",__func__); // #nocov
+}
+
+//! A value together with its gradient with respect to the parameters
+//! (lambda, mu, psi, chi), for forward-mode automatic differentiation.
+class grad_t {
+
+public:
+
+  double v;
+  double d[4];
+
+public:
+
+  //! a constant
+  grad_t (double x = 0) {
+    v = x;
+    for (int k = 0; k < 4; k++) d[k] = 0;
+  };
+  //! the value of the k-th parameter
+  grad_t (double x, int k) : grad_t(x) {
+    d[k] = 1;
+  };
+
+private:
+
+  //! apply a function with value f and derivative df at x.v
+  static grad_t chain (const grad_t& x, double f, double df) {
+    grad_t y = f;
+    for (int k = 0; k < 4; k++) y.d[k] = df*x.d[k];
+    return y;
+  };
+
+public:
+
+  friend grad_t operator+ (const grad_t& x, const grad_t& y) {
+    grad_t z = x.v+y.v;
+    for (int k = 0; k < 4; k++) z.d[k] = x.d[k]+y.d[k];
+    return z;
+  };
+  friend grad_t operator- (const grad_t& x, const grad_t& y) {
+    grad_t z = x.v-y.v;
+    for (int k = 0; k < 4; k++) z.d[k] = x.d[k]-y.d[k];
+    return z;
+  };
+  friend grad_t operator- (const grad_t& x) {
+    return chain(x,-x.v,-1);
+  };
+  friend grad_t operator* (const grad_t& x, const grad_t& y) {
+    grad_t z = x.v*y.v;
+    for (int k = 0; k < 4; k++) z.d[k] = x.d[k]*y.v+x.v*y.d[k];
+    return z;
+  };
+  friend grad_t operator/ (const grad_t& x, const grad_t& y) {
+    grad_t z = x.v/y.v;
+    for (int k = 0; k < 4; k++) z.d[k] = (x.d[k]-z.v*y.d[k])/y.v;
+    return z;
+  };
+  grad_t& operator+= (const grad_t& y) {
+    return *this = *this+y;
+  };
+  friend grad_t sqrt (const grad_t& x) {
+    double s = sqrt(x.v);
+    return chain(x,s,0.5/s);
+  };
+  friend grad_t exp (const grad_t& x) {
+    double e = exp(x.v);
+    return chain(x,e,e);
+  };
+  friend grad_t log (const grad_t& x) {
+    return chain(x,log(x.v),1/x.v);
+  };
+  friend grad_t log1p (const grad_t& x) {
+    return chain(x,log1p(x.v),1/(1+x.v));
+  };
+  friend grad_t tanh (const grad_t& x) {
+    double t = tanh(x.v);
+    return chain(x,t,1-t*t);
+  };
+  friend grad_t fabs (const grad_t& x) {
+    return (x.v < 0) ? -x : x;
+  };
+  friend double value (const grad_t& x) {
+    return x.v;
+  };
+
+};
+
+static inline double
+value
+(double x)
+{
+  return x;
+}
+
+//! log cosh(w), without overflow
+template <class T>
+static inline T
+log_cosh
+(T w)
+{
+  w = fabs(w);
+  return w + log1p(exp(-2*w)) - M_LN2;
+}
+
+// With w = d (t-tf)/2, T = tanh(w), c = b/d, and e = a/d,
+//   G(t) = (1+e T)/(1+c T),
+//   log H(t) = -2 (log cosh(w) + log(1+c T)).
+// Since |c| <= 1, neither overflows, however large |w| may be.
+
+//! sum of log H(t) over the given times
+template <class T>
+static T
+sum_log_H
+(const double *u, size_t n, T h, T c)
+{
+  T s = 0;
+  for (size_t i = 0; i < n; i++) {
+    T w = h*u[i];
+    s += log_cosh(w) + log1p(c*tanh(w));
+  }
+  return -2*s;
+}
+
+//! sum of log H(t), as above, vectorized
+template <>
+double
+sum_log_H
+(const double *u, size_t n, double h, double c)
+{
+  double s = 0;
+#pragma omp simd reduction(+:s)
+  for (size_t i = 0; i < n; i++) {
+    double w = h*u[i];
+    s += log_cosh(w) + log1p(c*tanh(w));
+  }
+  return -2*s;
+}
+
+//! sum of log((psi G(t)+chi)/H(t)) over the given times
+template <class T>
+static T
+sum_log_tip
+(const double *u, size_t n, T h, T c, T e, T psi, T chi)
+{
+  T s = 0;
+  for (size_t i = 0; i < n; i++) {
+    T w = h*u[i];
+    T th = tanh(w);
+    T g = (1+e*th)/(1+c*th);
+    s += log(psi*g+chi) + 2*(log_cosh(w)+log1p(c*th));
+  }
+  return s;
+}
+
+//! sum of log((psi G(t)+chi)/H(t)), as above, vectorized
+template <>
+double
+sum_log_tip
+(const double *u, size_t n, double h, double c, double e,
+ double psi, double chi)
+{
+  double s = 0;
+#pragma omp simd reduction(+:s)
+  for (size_t i = 0; i < n; i++) {
+    double w = h*u[i];
+    double th = tanh(w);
+    double g = (1+e*th)/(1+c*th);
+    s += log(psi*g+chi) + 2*(log_cosh(w)+log1p(c*th));
+  }
+  return s;
+}
+
+//! exact log likelihood at the parameters p = (lambda, mu, psi, chi)
+//! and initial population size n0.
+//! if n0 is NA, the likelihood is maximized over n0.
+//! with T = grad_t, the gradient with respect to p is computed too;
+//! the maximizing n0 is then held fixed.
+template <class T>
+static T
+lbdp_loglik
+(const lbdp_data_t& D, const T *p, double n0)
+{
+  T lambda = p[0], mu = p[1], psi = p[2], chi = p[3];
+  T a = lambda-mu+psi+chi;
+  T b = lambda-mu-psi-chi;
+  T d = sqrt(b*b+4*lambda*(psi+chi)); // guaranteed to be real
+  T h = d/2, c = b/d, e = a/d;
+  T th = tanh(h*D.t0);
+  T G0 = (1+e*th)/(1+c*th);
+  T logH0 = -2*(log_cosh(h*D.t0)+log1p(c*th));
+  n0 = ISNA(n0) ? floor(D.nroot/(1-value(G0))) : trunc(n0);
+  if (!R_FINITE(n0) || n0 < 0) return R_NaN;
+  int nrt = D.nroot;
+  size_t nbr = D.tbr.size();
+  return lchoose(n0,nrt)+lgammafn(nrt+1)+
+    (n0-nrt)*log(G0)+nrt*logH0+
+    ((D.ninline > 0) ? D.ninline*log(psi) : T(0))+
+    double(nbr)*log(2*lambda)+sum_log_H(D.tbr.data(),nbr,h,c)+
+    sum_log_tip(D.ttp.data(),D.ttp.size(),h,c,e,psi,chi);
+}
+
+//! the number of rows of the parameter matrix,
+//! which is checked
+static size_t
+lbdp_params
+(SEXP Params, const char *fn)
+{
+  size_t len = LENGTH(Params), n = len/5;
+  if (len != 5*n)
+    err("in '%s': 'params' must have 5 columns.",fn);
+  const double *par = REAL(Params);
+  for (size_t j = 0; j < n; j++) {
+    double n0 = par[j+4*n];
+    if (!ISNA(n0) && n0 < 0)
+      err("in '%s': 'n0' must be a positive integer.",fn);
+  }
+  return n;
+}
+
+extern "C" {
+
+  //! exact log likelihood of the genealogy at each row of the
+  //! parameter matrix Params, with columns lambda, mu, psi, chi, n0.
+  //! the genealogy is read (in place if possible) just once;
+  //! the rows are evaluated in parallel.
+  SEXP lbdp_exact_grid (SEXP Object, SEXP Params, SEXP Nthreads) {
+    int nthreads = *INTEGER(AS_INTEGER(Nthreads));
+    if (nthreads == NA_INTEGER || nthreads < 1) nthreads = 1;
+    PROTECT(Params = AS_NUMERIC(Params));
+    size_t n = lbdp_params(Params,__func__);
+    const double *par = REAL(Params);
+    lbdp_data_t D;
+    with_genealogy(Object,pre_prune|pre_obscure,
+                   [&] (const auto& A) {lbdp_data(A,D);});
+    SEXP out;
+    PROTECT(out = NEW_NUMERIC(n));
+    double *ll = REAL(out);
+#pragma omp parallel for num_threads(nthreads)
+    for (size_t j = 0; j < n; j++) {
+      double p[4];
+      for (int k = 0; k < 4; k++) p[k] = par[j+k*n];
+      ll[j] = lbdp_loglik(D,p,par[j+4*n]);
+    }
+    UNPROTECT(2);
+    return out;
+  }
+
+  //! exact log likelihood, as above, together with its gradient
+  //! with respect to lambda, mu, psi, and chi,
+  //! in a matrix with one row per row of Params.
+  SEXP lbdp_exact_grad (SEXP Object, SEXP Params, SEXP Nthreads) {
+    const char *colnames[] = {"loglik","lambda","mu","psi","chi"};
+    int nthreads = *INTEGER(AS_INTEGER(Nthreads));
+    if (nthreads == NA_INTEGER || nthreads < 1) nthreads = 1;
+    PROTECT(Params = AS_NUMERIC(Params));
+    size_t n = lbdp_params(Params,__func__);
+    const double *par = REAL(Params);
+    lbdp_data_t D;
+    with_genealogy(Object,pre_prune|pre_obscure,
+                   [&] (const auto& A) {lbdp_data(A,D);});
+    SEXP out, dimnm, nm;
+    PROTECT(out = Rf_allocMatrix(REALSXP,n,5));
+    PROTECT(dimnm = NEW_LIST(2));
+    PROTECT(nm = NEW_CHARACTER(5));
+    for (int k = 0; k < 5; k++) SET_STRING_ELT(nm,k,mkChar(colnames[k]));
+    SET_ELEMENT(dimnm,0,R_NilValue);
+    SET_ELEMENT(dimnm,1,nm);
+    SET_DIMNAMES(out,dimnm);
+    double *x = REAL(out);
+#pragma omp parallel for num_threads(nthreads)
+    for (size_t j = 0; j < n; j++) {
+      grad_t p[4];
+      for (int k = 0; k < 4; k++) p[k] = grad_t(par[j+k*n],k);
+      grad_t ll = lbdp_loglik(D,p,par[j+4*n]);
+      x[j] = ll.v;
+      for (int k = 0; k < 4; k++) x[j+(k+1)*n] = ll.d[k];
+    }
+    UNPROTECT(4);
+    return out;
+  }
+
+  //! exact log likelihood at the parameters Params (lambda, mu, psi,
+  //! chi, n0) of each of the genealogies in the list Objects,
+  //! which are read in place where possible and processed in parallel.
+  SEXP lbdp_exact_list (SEXP Objects, SEXP Params, SEXP Nthreads) {
+    int nthreads = *INTEGER(AS_INTEGER(Nthreads));
+    if (nthreads == NA_INTEGER || nthreads < 1) nthreads = 1;
+    PROTECT(Params = AS_NUMERIC(Params));
+    if (lbdp_params(Params,__func__) != 1)
+      err("in '%s': 'params' must be a single parameter set.",__func__);
+    const double *par = REAL(Params);
+    SEXP out;
+    PROTECT(out = NEW_NUMERIC(LENGTH(Objects)));
+    double *ll = REAL(out);
+    for_each_genealogy(Objects,pre_prune|pre_obscure,nthreads,
+                       [&] (size_t k, const auto& A) {
+                         lbdp_data_t D;
+                         lbdp_data(A,D);
+                         ll[k] = lbdp_loglik(D,par,par[4]);
+                       });
+    UNPROTECT(2);
+    return out;
+  }
+
+}
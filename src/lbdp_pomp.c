@@ -83,61 +83,86 @@ void lbdp_gill
  ){
   double tstep = 0.0, tmax = t + dt;
   const int *nodetype = get_userdata_int("nodetype");
+  const int *group = get_userdata_int("group");
+  const int nnode = *get_userdata_int("nnode");
   const int *sat = get_userdata_int("saturation");
   int parent = (int) nearbyint(node);
 
 #ifndef NDEBUG
-  int nnode = *get_userdata_int("nnode");
   assert(parent>=0);
   assert(parent<=nnode);
 #endif
 
   ll = 0;
 
-  // singular portion of filter equation
-  switch (nodetype[parent]) {
-  default:                      // non-genealogical event #nocov
-    break;                      // #nocov
-  case 0:                       // root
-    ell += 1;
-    break;
-  case 1:                       // sample
-    assert(n >= ell);
-    assert(ell >= 0);
-    if (sat[parent] == 1) {     // s=1
-      ll += log(psi);
-    } else if (sat[parent] == 0) { // s=0
-      ell -= 1;
-      double drate = chi*n;
-      double trate = drate+psi*(n-ell);
-      ll += (trate > 0) ? log(trate) : R_NegInf;
-      if (trate > 0 && unif_rand() < drate/trate) n -= 1;
-    } else {
-      assert(0);                // #nocov
-      ll += R_NegInf;           // #nocov
+  // singular portion of filter equation,
+  // at each of the simultaneous nodes of the group
+  do {
+    switch (nodetype[parent]) {
+    default:                    // non-genealogical event #nocov
+      break;                    // #nocov
+    case 0:                     // root
+      ell += 1;
+      break;
+    case 1:                     // sample
+      assert(n >= ell);
+      assert(ell >= 0);
+      if (sat[parent] == 1) {   // s=1
+        ll += log(psi);
+      } else if (sat[parent] == 0) { // s=0
+        ell -= 1;
+        double drate = chi*n;
+        double trate = drate+psi*(n-ell);
+        ll += (trate > 0) ? log(trate) : R_NegInf;
+        if (trate > 0 && unif_rand() < drate/trate) n -= 1;
+      } else {
+        assert(0);              // #nocov
+        ll += R_NegInf;         // #nocov
+      }
+      break;
+    case 2:                     // branch point s=2
+      assert(n >= 0);
+      assert(ell > 0);
+      assert(sat[parent]==2);
+      n += 1; ell += 1;
+      ll += log(2*lambda/n);
+      break;
     }
-    break;
-  case 2:                       // branch point s=2
-    ll = 0;
-    assert(n >= 0);
-    assert(ell > 0);
-    assert(sat[parent]==2);
-    n += 1; ell += 1;
-    ll += log(2*lambda/n);
-    break;
-  }
+  } while (++parent < nnode && group[parent] == group[parent-1]);
 
   if (tmax > t) {
 
-    // Gillespie steps:
+    // Gillespie steps, or, if tau > 0, tau leaps where these are safe:
     int event;
     double penalty = 0;
     double rate[2];
+    const double tau = *get_userdata_double("tau");
 
     double event_rate = EVENT_RATES;
-    tstep = exp_rand()/event_rate;
 
-    while (t + tstep < tmax) {
+    while (t < tmax) {
+      if (tau > 0) {
+        double h = (tmax - t < tau) ? tmax - t : tau;
+        h = leap_bound(h,n-ell,rate[0],rate[1]);
+        if (event_rate*h >= leap_min) {
+          double x0[2] = {n, ll};
+          // rates at the expected midpoint of the leap
+          n += nearbyint(0.5*h*(rate[0]-rate[1]));
+          EVENT_RATES;
+          ll -= penalty*h;
+          n = x0[0] + leap_count(rate[0],h) - leap_count(rate[1],h);
+          if (n >= ell) {
+            t = (h < tmax - t) ? t + h : tmax;
+            event_rate = EVENT_RATES;
+            continue;
+          }
+          // the leap overshot: take an exact step
+          n = x0[0]; ll = x0[1];
+          event_rate = EVENT_RATES;
+        }
+      }
+      tstep = exp_rand()/event_rate;
+      if (t + tstep >= tmax) break;
       event = rcateg(event_rate,rate,2);
       assert(event>=0 && event<2);
       ll -= penalty*tstep;
@@ -154,12 +179,11 @@ void lbdp_gill
       }
       t += tstep;
       event_rate = EVENT_RATES;
-      tstep = exp_rand()/event_rate;
     }
     tstep = tmax - t;
     ll -= penalty*tstep;
   }
-  node += 1;
+  node = parent;
 }
 
 # define lik  (__lik[0])
@@ -7,7 +7,11 @@
 
 #include "node.h"
 #include "genealogy.h"
+#include "genview.h"
+#include "cache.h"
 #include "internal.h"
+#include <algorithm>
+#include <vector>
 
 void
 node_t::lineage_incr
@@ -74,14 +78,124 @@ genealogy_t::lineage_count
   }
 }
 
-//! lineage count and saturation
-SEXP
+void
+genview_t::lineage_count
+(double *tout, int *deme,
+ int *ell, int *sat, int *etype) const
+{
+  std::vector<size_t> first, kid;
+  children(first,kid);
+  size_t nd = ndeme()+1;
+  slate_t tcur = timezero();
+  for (size_t j = 0; j < nd; j++) {
+    tout[j] = tcur;
+    deme[j] = j;
+    sat[j] = ell[j] = 0;
+    etype[j] = 0;
+  }
+  for (size_t s : _seq) {
+    if (tcur < _slate[s]) {
+      tout += nd; ell += nd; sat += nd;
+      deme += nd; etype += nd;
+      tcur = _slate[s];
+      for (size_t j = 0; j < nd; j++) {
+        tout[j] = tcur;
+        deme[j] = j;
+        ell[j] = (ell-nd)[j];
+        sat[j] = 0;
+        etype[j] = 0;
+      }
+    }
+    // as node_t::lineage_incr
+    const name_t d = _deme[s];
+    ell[d]--;
+    for (size_t j = first[s]; j < first[s+1]; j++) {
+      ell[_deme[kid[j]]]++;
+      sat[_deme[kid[j]]]++;
+    }
+    for (int k = 0; k < _nblack[s]; k++) {
+      name_t b = black_deme(s,k);
+      ell[b]++;
+      sat[b]++;
+    }
+    if (is_root(s)) {
+      ell[d]++;
+      etype[d] = -1;
+    } else if (_nblue[s] > 0) {
+      etype[d] = 1;
+    } else {
+      etype[d] = 2;
+    }
+  }
+  tout += nd; ell += nd; sat += nd;
+  deme += nd; etype += nd;
+  tcur = time();
+  for (size_t j = 0; j < nd; j++) {
+    tout[j] = tcur;
+    sat[j] = ell[j] = 0;
+    deme[j] = j;
+    etype[j] = 3;
+  }
+}
+
+//! lineage count on a grid of times.
+//! the nodes and the grid times are walked through together.
+//! the count at each grid time is that following all events
+//! at or before that time, as in the lineage-count function above,
+//! which drops to zero at the current time.
+void
 genealogy_t::lineage_count
-(void) const
+(const std::vector<slate_t>& grid, int *ell) const
+{
+  size_t nd = ndeme()+1;
+  std::vector<int> cur(nd,0), sat(nd,0), etype(nd,0);
+  size_t k = 0, ng = grid.size();
+  for (const node_t *p : *this) {
+    for ( ; k < ng && grid[k] < p->slate; k++, ell += nd)
+      std::copy(cur.begin(),cur.end(),ell);
+    p->lineage_incr(cur.data(),sat.data(),etype.data());
+  }
+  for ( ; k < ng && grid[k] < time(); k++, ell += nd)
+    std::copy(cur.begin(),cur.end(),ell);
+  for ( ; k < ng; k++, ell += nd)
+    std::fill(ell,ell+nd,0);
+}
+
+void
+genview_t::lineage_count
+(const std::vector<slate_t>& grid, int *ell) const
+{
+  std::vector<size_t> first, kid;
+  children(first,kid);
+  size_t nd = ndeme()+1;
+  std::vector<int> cur(nd,0);
+  size_t k = 0, ng = grid.size();
+  for (size_t s : _seq) {
+    for ( ; k < ng && grid[k] < _slate[s]; k++, ell += nd)
+      std::copy(cur.begin(),cur.end(),ell);
+    // as node_t::lineage_incr
+    cur[_deme[s]]--;
+    for (size_t j = first[s]; j < first[s+1]; j++)
+      cur[_deme[kid[j]]]++;
+    for (int b = 0; b < _nblack[s]; b++)
+      cur[black_deme(s,b)]++;
+    if (is_root(s)) cur[_deme[s]]++;
+  }
+  for ( ; k < ng && grid[k] < time(); k++, ell += nd)
+    std::copy(cur.begin(),cur.end(),ell);
+  for ( ; k < ng; k++, ell += nd)
+    std::fill(ell,ell+nd,0);
+}
+
+//! lineage count and saturation
+template <class TYPE>
+static SEXP
+lineage_list
+(const TYPE& G)
 {
   SEXP tout, deme, ell, sat, etype, out, outn;
-  int nt = ntime(timezero())+1;
-  int nl = (ndeme()+1)*nt;
+  int nt = G.ntime(G.timezero())+1;
+  int nl = (G.ndeme()+1)*nt;
   PROTECT(tout = NEW_NUMERIC(nl));
   PROTECT(deme = NEW_INTEGER(nl));
   PROTECT(ell = NEW_INTEGER(nl));
@@ -95,8 +209,86 @@ genealogy_t::lineage_count
   set_list_elem(out,outn,sat,"saturation",3);
   set_list_elem(out,outn,etype,"event_type",4);
   SET_NAMES(out,outn);
-  lineage_count(REAL(tout),INTEGER(deme),INTEGER(ell),
-                INTEGER(sat),INTEGER(etype));
+  G.lineage_count(REAL(tout),INTEGER(deme),INTEGER(ell),
+                  INTEGER(sat),INTEGER(etype));
   UNPROTECT(7);
   return out;
 }
+
+//! lineage count and saturation
+SEXP
+genealogy_t::lineage_count
+(void) const
+{
+  return lineage_list(*this);
+}
+
+//! lineage count and saturation
+SEXP
+genview_t::lineage_count
+(void) const
+{
+  return lineage_list(*this);
+}
+
+extern "C" {
+
+  //! lineage counts of a list of genealogies on a grid of times,
+  //! in an array of dimension (demes, times, genealogies).
+  //! the genealogies are pruned and/or obscured as requested;
+  //! there are as many demes as the genealogy with the most has,
+  //! counting the undeme.
+  //! as in 'cblv_array', genealogies are read in place, in chunks,
+  //! and processed in parallel.
+  SEXP lineages_grid (SEXP Objects, SEXP Grid, SEXP Prune, SEXP Obscure,
+                     SEXP Nthreads) {
+    PROTECT(Grid = AS_NUMERIC(Grid));
+    size_t ng = LENGTH(Grid);
+    std::vector<size_t> ord(ng);
+    for (size_t k = 0; k < ng; k++) {
+      if (ISNAN(REAL(Grid)[k]))
+        err("in '%s': 'grid' must not contain missing values.",__func__);
+      ord[k] = k;
+    }
+    std::stable_sort(ord.begin(),ord.end(),
+                     [&](size_t a, size_t b) {
+                       return REAL(Grid)[a] < REAL(Grid)[b];
+                     });
+    std::vector<slate_t> grid(ng);
+    for (size_t k = 0; k < ng; k++) grid[k] = REAL(Grid)[ord[k]];
+    int how = (*LOGICAL(AS_LOGICAL(Prune)) ? pre_prune : 0) |
+      (*LOGICAL(AS_LOGICAL(Obscure)) ? pre_obscure : 0);
+    size_t n = LENGTH(Objects);
+    int nthreads = *INTEGER(AS_INTEGER(Nthreads));
+    if (nthreads == NA_INTEGER || nthreads < 1) nthreads = 1;
+    std::vector<size_t> nd(n);
+    std::vector<std::vector<int>> ell(n);
+    for_each_genealogy(Objects,how,nthreads,
+                       [&] (size_t k, const auto& A) {
+                         nd[k] = A.ndeme()+1;
+                         ell[k].resize(nd[k]*ng);
+                         A.lineage_count(grid,ell[k].data());
+                       });
+    size_t ndmax = 1;
+    for (size_t i = 0; i < n; i++) {
+      if (nd[i] > ndmax) ndmax = nd[i];
+    }
+    SEXP out, dim;
+    PROTECT(dim = NEW_INTEGER(3));
+    INTEGER(dim)[0] = int(ndmax);
+    INTEGER(dim)[1] = int(ng);
+    INTEGER(dim)[2] = int(n);
+    PROTECT(out = Rf_allocArray(INTSXP,dim));
+    int *x = INTEGER(out);
+    for (size_t i = 0; i < n; i++) {
+      for (size_t k = 0; k < ng; k++) {
+        int *y = x+ndmax*(ord[k]+ng*i);
+        for (size_t d = 0; d < ndmax; d++)
+          y[d] = (d < nd[i]) ? ell[i][d+nd[i]*k] : 0;
+      }
+    }
+    UNPROTECT(3);
+    return out;
+  }
+
+}
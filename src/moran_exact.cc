@@ -0,0 +1,127 @@
+// Exact likelihood of the uniformly-sampled Moran process,
+// evaluated at many parameter sets.
+
+#include "genealogy.h"
+#include "cache.h"
+#include "genview.h"
+#include "internal.h"
+#include <map>
+#include <vector>
+
+//! The features of a (pruned, obscured) genealogy
+//! on which the exact likelihood depends.
+typedef struct {
+  double duration;              // length of the time interval
+  double exposure;              // sum of choose(ell,2) over the intervals
+  int ncoal;                    // number of coalescences
+  int nsamp;                    // number of samples (tip and ancestral)
+  int ellmax;                   // greatest lineage count
+  //! lineage counts at the tip samples, with their multiplicities
+  std::vector<std::pair<int,int>> tips;
+} moran_data_t;
+
+//! extract the features of the genealogy G from its
+//! lineage-count function, as in 'moran_exact'.
+template <class TYPE>
+static void
+moran_data
+(const TYPE& G, moran_data_t& D)
+{
+  size_t nt = G.ntime(G.timezero())+1;
+  assert(G.ndeme() == 0);       // genealogy should be obscured
+  std::vector<double> tout(nt);
+  std::vector<int> deme(nt), ell(nt), sat(nt), etype(nt);
+  G.lineage_count(tout.data(),deme.data(),ell.data(),sat.data(),etype.data());
+  std::map<int,int> tips;
+  D.duration = tout[nt-1]-tout[0];
+  D.exposure = 0;
+  D.ncoal = D.nsamp = D.ellmax = 0;
+  for (size_t i = 0; i+1 < nt; i++) {
+    double k = ell[i];
+    D.exposure += 0.5*k*(k-1)*(tout[i+1]-tout[i]);
+    if (ell[i] > D.ellmax) D.ellmax = ell[i];
+    if (i > 0) {
+      switch (ell[i]-ell[i-1]) {
+      case 1:                   // coalescence
+        D.ncoal++;
+        break;
+      case 0:                   // ancestral sample
+        D.nsamp++;
+        break;
+      case -1:                  // tip sample
+        D.nsamp++;
+        tips[ell[i]]++;
+        break;
+      default:
+        break;
+      }
+    }
+  }
+  D.tips.assign(tips.begin(),tips.end());
+}
+
+//! exact log likelihood at population size n,
+//! event rate mu, and sampling rate psi.
+static double
+moran_loglik
+(const moran_data_t& D, double n, double mu, double psi)
+{
+  if (D.ellmax > n || (!D.tips.empty() && D.tips.back().first >= n))
+    return R_NegInf;
+  double mfact = 2*mu/(n-1);    // = mu*n/choose(n,2)
+  double ll = -mfact*D.exposure-psi*n*D.duration+
+    D.ncoal*log(mfact)+D.nsamp*log(psi);
+  for (const std::pair<int,int>& t : D.tips)
+    ll += t.second*log(n-t.first);
+  return ll;
+}
+
+extern "C" {
+
+  //! exact log likelihood of the genealogy at each of the
+  //! parameter sets (N[j], Mu[j], Psi[j]), recycled as needed.
+  //! the genealogy is read (in place if possible) just once.
+  SEXP moran_exact (SEXP Object, SEXP N, SEXP Mu, SEXP Psi) {
+    PROTECT(N = AS_NUMERIC(N));
+    PROTECT(Mu = AS_NUMERIC(Mu));
+    PROTECT(Psi = AS_NUMERIC(Psi));
+    size_t nn = LENGTH(N), nm = LENGTH(Mu), np = LENGTH(Psi);
+    size_t n = (nn == 0 || nm == 0 || np == 0) ? 0 :
+      std::max(nn,std::max(nm,np));
+    moran_data_t D;
+    with_genealogy(Object,pre_prune|pre_obscure,
+                   [&] (const auto& A) {moran_data(A,D);});
+    SEXP out;
+    PROTECT(out = NEW_NUMERIC(n));
+    double *ll = REAL(out);
+    const double *xn = REAL(N), *xm = REAL(Mu), *xp = REAL(Psi);
+    for (size_t j = 0; j < n; j++)
+      ll[j] = moran_loglik(D,xn[j%nn],xm[j%nm],xp[j%np]);
+    UNPROTECT(4);
+    return out;
+  }
+
+  //! exact log likelihood at population size N, event rate Mu,
+  //! and sampling rate Psi of each of the genealogies in the list Objects,
+  //! which are read in place where possible and processed in parallel.
+  SEXP moran_exact_list (SEXP Objects, SEXP N, SEXP Mu, SEXP Psi,
+                         SEXP Nthreads) {
+    int nthreads = *INTEGER(AS_INTEGER(Nthreads));
+    if (nthreads == NA_INTEGER || nthreads < 1) nthreads = 1;
+    double n = *REAL(AS_NUMERIC(N));
+    double mu = *REAL(AS_NUMERIC(Mu));
+    double psi = *REAL(AS_NUMERIC(Psi));
+    SEXP out;
+    PROTECT(out = NEW_NUMERIC(LENGTH(Objects)));
+    double *ll = REAL(out);
+    for_each_genealogy(Objects,pre_prune|pre_obscure,nthreads,
+                       [&] (size_t k, const auto& A) {
+                         moran_data_t D;
+                         moran_data(A,D);
+                         ll[k] = moran_loglik(D,n,mu,psi);
+                       });
+    UNPROTECT(1);
+    return out;
+  }
+
+}
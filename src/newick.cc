@@ -2,6 +2,7 @@
 #include "node.h"
 #include "nodeseq.h"
 #include "genealogy.h"
+#include "genview.h"
 #include "internal.h"
 
 #include <R.h>
@@ -108,3 +109,71 @@ genealogy_t::newick
 {
   return nodeseq_t::newick(time(),timezero(),(ndeme() > 0),extended);
 }
+
+//! Newick format for the subtree rooted at node s.
+//! see node_t::newick and ball_t::newick.
+string_t
+genview_t::newick
+(size_t s, const std::vector<size_t>& first,
+ const std::vector<size_t>& kid,
+ const slate_t& tnow, const slate_t& tpar,
+ bool showdeme, bool extended) const
+{
+  string_t o1 = "", o2 = "", o3 = "";
+  int n = nchildren(s);
+  if (n > 0) {
+    o1 = "("; o3 = ")";
+  }
+  if (extended) {
+    o3 += "[&&PhyloPOMP ";
+    if (_nblue[s] > 0)
+      o3 += "type=sample";
+    else if (is_root(s))
+      o3 += "type=root";
+    else
+      o3 += "type=node";
+    if (showdeme && _deme[s] != undeme)
+      o3 += " deme=" + std::to_string(_deme[s]);
+    o3 += "]";
+  }
+  n = 0;
+  for (size_t j = first[s]; j < first[s+1]; j++) {
+    if (n++ > 0) o2 += ",";
+    o2 += newick(kid[j],first,kid,tnow,_slate[s],showdeme,extended);
+  }
+  for (int k = 0; k < _nblack[s]; k++) {
+    assert(extended);
+    name_t d = black_deme(s,k);
+    if (n++ > 0) o2 += ",";
+    o2 += "[&&PhyloPOMP type=extant";
+    if (showdeme && d != undeme)
+      o2 += " deme=" + std::to_string(d);
+    o2 += "]:" + double2string(tnow-_slate[s]);
+  }
+  return o1 + o2 + o3
+    + ":" + double2string(_slate[s] - tpar);
+}
+
+//! put genealogy at current time into Newick format.
+string_t
+genview_t::newick
+(bool extended) const
+{
+  std::vector<size_t> first, kid;
+  children(first,kid);
+  // children are visited in pocket order, i.e., by name
+  for (size_t s : _seq) {
+    std::sort(kid.begin()+first[s],kid.begin()+first[s+1],
+              [this](size_t a, size_t b) {
+                return _uniq[a] < _uniq[b];
+              });
+  }
+  bool showdeme = (ndeme() > 0);
+  string_t o = "";
+  for (size_t s : _seq) {
+    if (is_root(s)) {
+      o += newick(s,first,kid,time(),timezero(),showdeme,extended) + ";";
+    }
+  }
+  return o;
+}
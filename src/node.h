@@ -36,30 +36,79 @@ public:
 
 public:
 
-  //! size of binary serialization
+  //! size of binary serialization.
+  //! the slate and the parent are encoded by the enclosing sequence.
+  //! green balls are not written:
+  //! each is reconstructed from the node that owns it.
   size_t bytesize (void) const {
-    return 2*sizeof(name_t) + sizeof(slate_t)
-      + pocket_t::bytesize();
+    size_t s = varint_size(uniq) + varint_size(lineage_code())
+      + varint_size(deme());
+    size_t n = 0;
+    for (ball_t *b : *this) {
+      if (!b->is(green)) {
+        s += b->bytesize(); n++;
+      }
+    }
+    return s + varint_size(n);
   };
-  //! binary serialization of node_t
+  //! binary serialization of node_t (less slate and parent)
   friend raw_t* operator>> (const node_t &p, raw_t *o) {
-    name_t buf[2] = {p.uniq, p._lineage};
-    memcpy(o,buf,sizeof(buf)); o += sizeof(buf);
-    memcpy(o,&p.slate,sizeof(slate_t)); o += sizeof(slate_t);
-    return reinterpret_cast<const pocket_t&>(p) >> o;
+    size_t n = 0;
+    for (ball_t *b : p) {
+      if (!b->is(green)) n++;
+    }
+    o = put_varint(o,p.uniq);
+    o = put_varint(o,p.lineage_code());
+    o = put_varint(o,p.deme());
+    o = put_varint(o,n);
+    for (ball_t *b : p) {
+      if (!b->is(green)) o = (*b >> o);
+    }
+    return o;
   };
-  //! binary deserialization of node_t
+  //! binary deserialization of node_t (less slate and parent).
+  //! this creates the node's own green ball,
+  //! but does not place it in its parent's pocket.
   friend raw_t* operator>> (raw_t *o, node_t &p) {
+    p.clean();
+    name_t lc, d;
+    size_t n;
+    o = get_varint(o,p.uniq);
+    o = get_varint(o,lc);
+    o = get_varint(o,d);
+    o = get_varint(o,n);
+    p._lineage = (lc == 0) ? null_lineage : lc-1;
+    p._green_ball = new ball_t(&p,p.uniq,green,d);
+    for (size_t i = 0; i < n; i++) {
+      ball_t *b = new ball_t();
+      o = (o >> *b);
+      if (b->is(green))
+        err("in %s: corrupted genealogy serialization.",__func__); // #nocov
+      p.insert(b);
+    }
+    return o;
+  };
+  //! legacy (fixed-width) binary deserialization of node_t
+  friend raw_t* legacy (raw_t *o, node_t &p) {
     p.clean();
     name_t buf[2];
     memcpy(buf,o,sizeof(buf)); o += sizeof(buf);
     memcpy(&p.slate,o,sizeof(slate_t)); o += sizeof(slate_t);
     p.uniq = buf[0]; p._lineage = buf[1];
-    o = (o >> reinterpret_cast<pocket_t&>(p));
+    o = legacy(o,reinterpret_cast<pocket_t&>(p));
     p.repair_holder(&p);
     return o;
   };
 
+private:
+
+  //! lineage, shifted so that the null lineage is 0
+  name_t lineage_code (void) const {
+    return (_lineage == null_lineage) ? 0 : _lineage+1;
+  };
+
+public:
+
   void reuniqify (name_t shift);
 
 public:
@@ -149,17 +198,6 @@ public:
   //! -  2 = non-sample node
   void lineage_incr (int *incr, int *sat, int *etype) const;
 
-  //! distance along the genealogy from given node back to the nearest
-  //! already-visited ancestor.
-  slate_t joining_branch_length (const std::unordered_map<name_t, bool>&) const;
-
-  //! Recursive in-order walk over the subtree rooted at node p.
-  //! - at leaf node, push added branch length into x
-  //! - at internal node, push height into y
-  void cblv (std::vector<slate_t>&, std::vector<slate_t>&,
-             std::unordered_map<name_t, bool>&,
-             const std::unordered_map<name_t,std::vector<node_t*>>&,
-             slate_t) const;
 
 public:
 
@@ -38,41 +38,96 @@ public:
   // SERIALIZATION
   //! size of serialized binary form
   size_t bytesize (void) const {
-    size_t s = sizeof(size_t);
-    for (node_t *p : *this)
-      s += p->bytesize();
+    std::unordered_map<name_t,size_t> ord = ordinals();
+    size_t s = varint_size(size());
+    size_t i = 0;
+    slate_t t = 0;
+    for (node_t *p : *this) {
+      int64_t j = ord.at(p->parent()->uniq);
+      s += slate_size(p->slate,t) + varint_size(zigzag(j-int64_t(i)))
+        + p->bytesize();
+      t = p->slate;
+      i++;
+    }
     return s;
   };
-  //! binary serialization
+  //! binary serialization.
+  //! each slate is encoded relative to that of the preceding node;
+  //! each parent, by its position relative to that of the child.
   friend raw_t* operator>> (const nodeseq_t& G, raw_t* o) {
-    size_t nnode = G.size();
-    memcpy(o,&nnode,sizeof(size_t)); o += sizeof(size_t);
+    std::unordered_map<name_t,size_t> ord = G.ordinals();
+    o = put_varint(o,G.size());
+    size_t i = 0;
+    slate_t t = 0;
     for (node_t *p : G) {
+      int64_t j = ord.at(p->parent()->uniq);
+      o = put_slate(o,p->slate,t);
+      o = put_varint(o,zigzag(j-int64_t(i)));
       o = (*p >> o);
+      t = p->slate;
+      i++;
     }
     return o;
   };
-  //! binary deserialization
+  //! binary deserialization.
+  //! since parents are identified by position,
+  //! all links are restored in a single pass.
   friend raw_t* operator>> (raw_t* o, nodeseq_t& G) {
     G.clean();
-    std::unordered_map<name_t,node_t*> node_names;
-    std::unordered_map<name_t,ball_t*> ball_names;
+    size_t nnode = 0;
+    o = get_varint(o,nnode);
+    std::vector<node_t*> node(nnode);
+    for (size_t i = 0; i < nnode; i++) {
+      node[i] = new node_t();
+      G.push_back(node[i]);
+    }
+    slate_t t = 0;
+    for (size_t i = 0; i < nnode; i++) {
+      node_t *p = node[i];
+      uint64_t z;
+      o = get_slate(o,p->slate,t);
+      o = get_varint(o,z);
+      int64_t j = int64_t(i) + unzigzag(z);
+      if (j < 0 || j >= int64_t(nnode))
+        err("in %s: corrupted genealogy serialization.",__func__); // #nocov
+      o = (o >> *p);
+      node[j]->insert(p->green_ball());
+      t = p->slate;
+    }
+    G.trace_lineages();
+    return o;
+  };
+  //! legacy (fixed-width) binary deserialization
+  friend raw_t* legacy (raw_t* o, nodeseq_t& G) {
+    G.clean();
     size_t nnode = 0;
     memcpy(&nnode,o,sizeof(size_t)); o += sizeof(size_t);
-    node_names.reserve(nnode);
-    ball_names.reserve(nnode);
     for (size_t i = 0; i < nnode; i++) {
       node_t *p = new node_t();
-      o = (o >> *p);
+      o = legacy(o,*p);
       G.push_back(p);
+    }
+    G.relink();
+    return o;
+  };
+
+private:
+
+  //! Restore the links between nodes and green balls.
+  //! Needed in deserialization.
+  void relink (void) {
+    std::unordered_map<name_t,node_t*> node_names;
+    std::unordered_map<name_t,ball_t*> ball_names;
+    node_names.reserve(size());
+    ball_names.reserve(size());
+    for (node_t *p : *this) {
       node_names[p->uniq] = p;
     }
-    for (node_t *q : G) {
+    for (node_t *q : *this) {
       q->repair_owners(node_names,&ball_names);
     }
-    G.repair_owners(ball_names);
-    G.trace_lineages();
-    return o;
+    repair_owners(ball_names);
+    trace_lineages();
   };
 
 private:
@@ -85,6 +140,17 @@ private:
     }
   };
 
+  //! map node names onto positions in the sequence
+  std::unordered_map<name_t,size_t>
+  ordinals (void) const {
+    std::unordered_map<name_t,size_t> m;
+    m.reserve(size());
+    size_t i = 0;
+    for (node_t* p : *this)
+      m[p->uniq] = i++;
+    return m;
+  };
+
   //! map node names onto pointers
   std::unordered_map<name_t, node_t*>
   node_map (void) const {
@@ -97,20 +163,64 @@ private:
 
 public:
 
+  //! number of ancestors of p that lie at the same time as p.
+  static size_t tie_depth (const node_t *p) {
+    size_t d = 0;
+    while (!p->is_root() && p->parent()->slate == p->slate) {
+      p = p->parent();
+      d++;
+    }
+    return d;
+  };
   //! Order relation among nodes.
   //! An ancestor node should always come before its descendants.
-  //! Nodes should be ordered by time, then arbitrarily.
+  //! Nodes are ordered by time, then by the number of their ancestors
+  //! at the same time, then by unique name.
+  //! This is a strict total order, so that the sorted order is unique.
   static bool compare (node_t* p, node_t* q) {
-    return (p->slate < q->slate) ||
-      ((p->slate == q->slate) &&
-       ((p == q->parent()) ||
-        ((q != p->parent()) && (p->uniq < q->uniq))));
+    if (p->slate < q->slate) return true;
+    if (q->slate < p->slate) return false;
+    size_t dp = tie_depth(p), dq = tie_depth(q);
+    return (dp < dq) || ((dp == dq) && (p->uniq < q->uniq));
   };
 
   //! order nodes in order of increasing time
   void sort (void) {
     std::list<node_t*>::sort(compare);
   };
+  //! restore the order of the sequence, with the same result as sort().
+  //! only the stretch between the first and last out-of-order nodes
+  //! is sorted, and is then merged back in.
+  //! thus, an ordered sequence is merely checked,
+  //! and one with a few nodes out of place is cheaply repaired.
+  void reorder (void) {
+    if (size() < 2) return;
+    node_nit a = end(), b = end();
+    for (node_nit i = begin(), j = std::next(i); j != end(); i = j++) {
+      if (compare(*j,*i)) {
+        if (a == end()) a = i;
+        b = std::next(j);
+      }
+    }
+    if (a == end()) return;
+    std::list<node_t*> s;
+    s.splice(s.end(),*this,a,b);
+    if (b != begin() && b != end() && compare(*b,*std::prev(b))) {
+      splice(b,s);
+      sort();
+    } else {
+      s.sort(compare);
+      merge(s,compare);
+    }
+  };
+  //! insert node p in order, searching forward from 'hint'.
+  //! p is placed before the first node that does not precede it.
+  //! the sequence should be ordered from 'hint' on,
+  //! and p should belong nowhere before 'hint'.
+  node_nit place (node_t *p, node_nit hint) {
+    while (hint != end() && compare(*hint,p)) hint++;
+    return insert(hint,p);
+  };
 
 public:
 
@@ -212,22 +322,13 @@ public:
     node_nit j = begin();
     while (j != end()) {
       if ((*j)->dead_root()) {
-        destroy_node(*(j++));
+        delete *j;
+        j = erase(j);
       } else {
         j++;
       }
     }
   };
-  //! drop all inline nodes
-  //! i.e., those holding just one ball that is green.
-  void comb (void) {
-    for (node_t *p : *this) {
-      if (p->size() == 1 && p->holds(green)) {
-        swap(p->last_ball(),p->green_ball());
-      }
-    }
-    weed();
-  };
 
 private:
 
@@ -244,61 +345,32 @@ private:
 
 public:
 
-  //! map nodes onto vector of children
-  std::unordered_map<name_t, std::vector<node_t*>>
-  children_map (void) const {
-    std::unordered_map<name_t, std::vector<node_t*>> children;
-    children.reserve(size());
-    // initialise every node with an empty vector
-    for (node_t* p : *this)
-      children[p->uniq];
-    for (node_t* p : *this) {
-      if (!p->is_root())
-        children[p->parent()->uniq].push_back(p);
+  //! dense form of the sequence, with nodes numbered by position:
+  //! par[i] is the position of the parent of node i
+  //! (i itself for a root) and tm[i] is the time of node i.
+  void dense (std::vector<size_t>& par, std::vector<slate_t>& tm) const {
+    std::unordered_map<name_t,size_t> ord = ordinals();
+    par.clear(); tm.clear();
+    par.reserve(size()); tm.reserve(size());
+    for (node_t *p : *this) {
+      par.push_back(ord.at(p->parent()->uniq));
+      tm.push_back(p->slate);
     }
-    return children;
   };
-
-  //! collect root nodes and sort them in order of decreasing subtree height
-  std::vector<node_t*>
-  sorted_roots
-  (
-   const std::unordered_map<name_t, slate_t>& height
-   ) const {
-    std::vector<node_t*> roots;
-    for (node_t* p : *this)
-      if (p->is_root()) roots.push_back(p);
-    std::sort(roots.begin(), roots.end(),
-              [&height](node_t* a, node_t* b) {
-                return height.at(a->uniq) > height.at(b->uniq);
-              });
-    return roots;
-  };
-
-  //! ladderize the tree by sorting each vector in 'children' according
-  //! to decreasing subtree height. Return the root nodes, sorted in the
-  //! same way.
-  std::vector<node_t*>
-  ladderize
-  (
-   std::unordered_map<name_t,std::vector<node_t*>>& children
-   ) const {
-    std::unordered_map<name_t, slate_t> height;
-    height.reserve(size());
-    for (auto it = rbegin(); it != rend(); ++it) {
-      node_t* p = *it;
-      auto& ch = children.at(p->uniq);
-      if (ch.empty()) {
-        height[p->uniq] = p->slate;
-      } else {
-        std::sort(ch.begin(), ch.end(),
-                  [&height](node_t* a, node_t* b) {
-                    return height.at(a->uniq) > height.at(b->uniq);
-                  });
-        height[p->uniq] = height.at(ch[0]->uniq);
+  //! dense form, as above, together with
+  //! the number of samples (blue balls) held by each node.
+  void dense (std::vector<size_t>& par, std::vector<slate_t>& tm,
+              std::vector<int>& nblue) const {
+    dense(par,tm);
+    nblue.clear();
+    nblue.reserve(size());
+    for (node_t *p : *this) {
+      int n = 0;
+      for (ball_t *b : *p) {
+        if (b->is(blue)) n++;
       }
+      nblue.push_back(n);
     }
-    return sorted_roots(height);
   };
 
 public:
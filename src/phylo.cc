@@ -0,0 +1,268 @@
+// Conversion of genealogies to 'phylo' objects (package 'ape')
+
+#include "genealogy.h"
+#include "cache.h"
+#include "genview.h"
+#include "internal.h"
+#include <vector>
+
+//! Node types in the 'phylo' representation.
+typedef enum {ph_sample, ph_extant, ph_node, ph_root} phtype_t;
+
+static const char *phtype_names[] = {"sample", "extant", "node", "root"};
+
+//! assemble a 'phylo' object from a flattened genealogy:
+//! par[i] is the parent of entry i (i itself for a root) and
+//! tm[i], deme[i], type[i] are its time, deme, and type.
+//! samp[i] is the number of the sample held by entry i,
+//! if any, or of the extant lineage it represents.
+//! parents precede their children.
+//! the tree is written in preorder ('cladewise' order in 'ape'),
+//! the tips being numbered in the order they are visited.
+//! several roots are joined at a further root, at time t0.
+static SEXP
+make_phylo
+(
+ const std::vector<size_t>& par,
+ const std::vector<slate_t>& tm,
+ const std::vector<int>& deme,
+ const std::vector<int>& type,
+ const std::vector<size_t>& samp,
+ slate_t t0
+ )
+{
+  size_t n = par.size();
+  if (n == 0) err("in '%s': the genealogy is empty.",__func__);
+  // children, in order
+  std::vector<size_t> first(n+1,0), kid(n), fill;
+  std::vector<size_t> roots;
+  for (size_t i = 0; i < n; i++) {
+    if (par[i] != i) first[par[i]+1]++;
+    else roots.push_back(i);
+  }
+  for (size_t i = 0; i < n; i++) first[i+1] += first[i];
+  fill.assign(first.begin(),first.end()-1);
+  for (size_t i = 0; i < n; i++) {
+    if (par[i] != i) kid[fill[par[i]]++] = i;
+  }
+  // preorder
+  std::vector<size_t> pre, stack;
+  pre.reserve(n);
+  for (size_t r : roots) {
+    stack.push_back(r);
+    while (!stack.empty()) {
+      size_t i = stack.back();
+      stack.pop_back();
+      pre.push_back(i);
+      for (size_t j = first[i+1]; j-- > first[i]; ) stack.push_back(kid[j]);
+    }
+  }
+  // numbering: tips first, then the internal nodes
+  bool join = (roots.size() > 1);
+  size_t ntip = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (first[i] == first[i+1]) ntip++;
+  }
+  size_t nnode = n - ntip + (join ? 1 : 0);
+  std::vector<int> id(n);
+  int nt = 0, nn = int(ntip) + (join ? 1 : 0);
+  for (size_t i : pre) {
+    id[i] = (first[i] == first[i+1]) ? ++nt : ++nn;
+  }
+  size_t nedge = n - (join ? 0 : 1);
+  SEXP out, outn, edge, elen, tlab, nlab, dm, ty;
+  PROTECT(edge = Rf_allocMatrix(INTSXP,nedge,2));
+  PROTECT(elen = NEW_NUMERIC(nedge));
+  PROTECT(tlab = NEW_CHARACTER(ntip));
+  PROTECT(nlab = NEW_CHARACTER(nnode));
+  PROTECT(dm = NEW_INTEGER(ntip+nnode));
+  PROTECT(ty = NEW_CHARACTER(ntip+nnode));
+  int *e = INTEGER(edge);
+  double *el = REAL(elen);
+  size_t k = 0;
+  for (size_t i : pre) {
+    if (par[i] != i) {
+      e[k] = id[par[i]];
+      el[k] = tm[i]-tm[par[i]];
+    } else if (join) {
+      e[k] = int(ntip)+1;
+      el[k] = tm[i]-t0;
+    } else {
+      continue;
+    }
+    e[k+nedge] = id[i];
+    k++;
+  }
+  char buf[32];
+  for (size_t i : pre) {
+    int j = id[i]-1;
+    const char *lab = "";
+    if (type[i] == ph_sample || type[i] == ph_extant) {
+      snprintf(buf,sizeof(buf),"%c%zu",(type[i] == ph_sample) ? 's' : 'e',
+               samp[i]);
+      lab = buf;
+    }
+    if (j < int(ntip)) SET_STRING_ELT(tlab,j,mkChar(lab));
+    else SET_STRING_ELT(nlab,j-ntip,mkChar(lab));
+    INTEGER(dm)[j] = deme[i];
+    SET_STRING_ELT(ty,j,mkChar(phtype_names[type[i]]));
+  }
+  if (join) {
+    SET_STRING_ELT(nlab,0,mkChar(""));
+    INTEGER(dm)[ntip] = NA_INTEGER;
+    SET_STRING_ELT(ty,ntip,NA_STRING);
+  }
+  PROTECT(out = NEW_LIST(8));
+  PROTECT(outn = NEW_CHARACTER(8));
+  k = 0;
+  k = set_list_elem(out,outn,edge,"edge",k);
+  k = set_list_elem(out,outn,elen,"edge.length",k);
+  k = set_list_elem(out,outn,tlab,"tip.label",k);
+  k = set_list_elem(out,outn,ScalarInteger(int(nnode)),"Nnode",k);
+  k = set_list_elem(out,outn,nlab,"node.label",k);
+  k = set_list_elem(out,outn,
+                    ScalarReal(join ? 0 : tm[roots[0]]-t0),"root.edge",k);
+  k = set_list_elem(out,outn,dm,"deme",k);
+  k = set_list_elem(out,outn,ty,"type",k);
+  SET_NAMES(out,outn);
+  SET_ATTR(out,install("class"),mkString("phylo"));
+  SET_ATTR(out,install("order"),mkString("cladewise"));
+  UNPROTECT(8);
+  return out;
+}
+
+//! samples as tips:
+//! each of the first nblue.size() entries holds nblue[i] samples,
+//! the first of which is numbered samp[i].
+//! an entry holding just one sample, without children, is a sample tip.
+//! the samples of any other entry are moved onto new tips,
+//! at the ends of zero-length branches (cf. insert_zlb),
+//! so that every sample keeps its label.
+static void
+sample_tips
+(
+ std::vector<size_t>& par,
+ std::vector<slate_t>& tm,
+ std::vector<int>& deme,
+ std::vector<int>& type,
+ std::vector<size_t>& samp,
+ const std::vector<int>& nblue
+ )
+{
+  size_t n = nblue.size();
+  std::vector<int> nkid(n,0);
+  for (size_t j = 0; j < par.size(); j++) {
+    if (par[j] != j && par[j] < n) nkid[par[j]]++;
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (nblue[i] == 0) continue;
+    if (nblue[i] == 1 && nkid[i] == 0 && par[i] != i) {
+      type[i] = ph_sample;
+      continue;
+    }
+    slate_t t = tm[i];
+    int d = deme[i];
+    for (int k = 0; k < nblue[i]; k++) {
+      par.push_back(i);
+      tm.push_back(t);
+      deme.push_back(d);
+      type.push_back(ph_sample);
+      samp.push_back(samp[i]+k);
+    }
+  }
+}
+
+//! 'phylo' representation.
+//! samples are numbered in order, as are the extant lineages.
+SEXP
+genealogy_t::phylo
+(void) const
+{
+  std::vector<size_t> par, samp;
+  std::vector<slate_t> tm;
+  std::vector<int> deme, type, nblue;
+  std::vector<name_t> xdeme;
+  std::vector<size_t> xpar;
+  dense(par,tm);
+  size_t i = 0, ns = 0;
+  for (const node_t *p : *this) {
+    size_t nb = 0;
+    for (const ball_t *b : *p) {
+      if (b->is(blue)) nb++;
+      else if (b->is(black)) {
+        xpar.push_back(i);
+        xdeme.push_back(b->deme());
+      }
+    }
+    deme.push_back(p->deme());
+    type.push_back((p->is_root()) ? ph_root : ph_node);
+    samp.push_back(ns+1);
+    nblue.push_back(int(nb));
+    ns += nb;
+    i++;
+  }
+  for (size_t j = 0; j < xpar.size(); j++) {
+    par.push_back(xpar[j]);
+    tm.push_back(time());
+    deme.push_back(xdeme[j]);
+    type.push_back(ph_extant);
+    samp.push_back(j+1);
+  }
+  sample_tips(par,tm,deme,type,samp,nblue);
+  return make_phylo(par,tm,deme,type,samp,timezero());
+}
+
+//! 'phylo' representation. see genealogy_t::phylo.
+SEXP
+genview_t::phylo
+(void) const
+{
+  std::vector<size_t> par, samp;
+  std::vector<slate_t> tm;
+  std::vector<int> deme, type, nblue;
+  std::vector<name_t> xdeme;
+  std::vector<size_t> xpar;
+  dense(par,tm);
+  size_t i = 0, ns = 0;
+  for (size_t s : _seq) {
+    for (int k = 0; k < _nblack[s]; k++) {
+      xpar.push_back(i);
+      xdeme.push_back(black_deme(s,k));
+    }
+    deme.push_back(_deme[s]);
+    type.push_back(is_root(s) ? ph_root : ph_node);
+    samp.push_back(ns+1);
+    nblue.push_back(_nblue[s]);
+    ns += _nblue[s];
+    i++;
+  }
+  for (size_t j = 0; j < xpar.size(); j++) {
+    par.push_back(xpar[j]);
+    tm.push_back(time());
+    deme.push_back(xdeme[j]);
+    type.push_back(ph_extant);
+    samp.push_back(j+1);
+  }
+  sample_tips(par,tm,deme,type,samp,nblue);
+  return make_phylo(par,tm,deme,type,samp,timezero());
+}
+
+extern "C" {
+
+  //! 'phylo' representation of a genealogy,
+  //! pruned and/or obscured as requested.
+  //! the genealogy is read in place if possible.
+  SEXP phylo (SEXP Object, SEXP Prune, SEXP Obscure) {
+    int how = (*LOGICAL(AS_LOGICAL(Prune)) ? pre_prune : 0) |
+      (*LOGICAL(AS_LOGICAL(Obscure)) ? pre_obscure : 0);
+    gencache_t& cache = genealogy_cache();
+    const genealogy_t *G = cache.find(Object,how);
+    if (G == 0 && genview_t::readable(Object)) {
+      genview_t V = Object;
+      if (V.sorted()) return preprocess(V,how).phylo();
+    }
+    if (G == 0) G = cache.fetch(Object,how);
+    return G->phylo();
+  }
+
+}
@@ -42,12 +42,14 @@ public:
   // SERIALIZATION
   //! size of binary serialization
   size_t bytesize (void) const {
-    return sizeof(size_t) + size()*(ball_t::bytesize);
+    size_t s = varint_size(size());
+    for (ball_t *i : *this)
+      s += i->bytesize();
+    return s;
   };
   //! binary serialization
   friend raw_t* operator>> (const pocket_t &p, raw_t *o) {
-    size_t psize = p.size();
-    memcpy(o,&psize,sizeof(size_t)); o += sizeof(size_t);
+    o = put_varint(o,p.size());
     for (ball_t *i : p)
       o = (*i >> o);
     return o;
@@ -57,10 +59,23 @@ public:
   friend raw_t* operator>> (raw_t *o, pocket_t &p) {
     p.clean();
     size_t psize;
-    memcpy(&psize,o,sizeof(size_t)); o += sizeof(size_t);
+    o = get_varint(o,psize);
     for (size_t i = 0; i < psize; i++) {
       ball_t *b = new ball_t();
       o = (o >> *b);
+      p.insert(p.end(),b);
+    }
+    return o;
+  };
+  //! legacy (fixed-width) binary deserialization.
+  //! this leaves the balls without knowledge of their holder.
+  friend raw_t* legacy (raw_t *o, pocket_t &p) {
+    p.clean();
+    size_t psize;
+    memcpy(&psize,o,sizeof(size_t)); o += sizeof(size_t);
+    for (size_t i = 0; i < psize; i++) {
+      ball_t *b = new ball_t();
+      o = legacy(o,*b);
       p.insert(b);
     }
     return o;
@@ -4,7 +4,9 @@
 #define Exposed  1
 #define Infected 2
 
-static const int nrate = 6;
+static const int nrate = 7;
+// events that move a lineage between demes
+static const int lineage_event[] = {0, 1, 0, 1, 0, 0, 1};
 
 static inline int random_choice (double n) {
   return floor(R_unif_index(n));
@@ -48,7 +50,8 @@ static void change_color (double *color, int nsample,
 #define EVENT_RATES                                     \
   event_rates(__x,__p,t,                                \
               __stateindex,__parindex,__covindex,       \
-              __covars,rate,logpi,&penalty)             \
+              __covars,rate,logpi,&penalty,             \
+              glin,dt,&glog)                            \
 
 static double event_rates
 (
@@ -61,7 +64,10 @@ static double event_rates
  const double *__covars,
  double *rate,
  double *logpi,
- double *penalty
+ double *penalty,
+ int glin,
+ double dt,
+ double *glog
  ) {
   double event_rate = 0;
   double alpha, pi;
@@ -102,12 +108,40 @@ static double event_rates
   // 5: waning
   event_rate += (*rate = omega*R); rate++;
   *logpi = 0; logpi++;
+  // 6: guided progression of lineage 'glin', s=(0,1) (cf. 'guide_rate')
+  const double *color = &COLOR;
+  if (glin >= 0 && nearbyint(color[glin]) == Exposed) {
+    event_rate += (*rate = guide_rate(sigma,dt,glog));
+    *logpi = -log(E);           // as for event 3
+    *penalty -= *rate;
+  } else {
+    *rate = 0;
+    *logpi = 0;
+    *glog = 0;
+  }
+  rate++; logpi++;
   // sampling (Q = 0): non-destructive (psi) + destructive (chi)
   *penalty += (psi+chi)*I;
   assert(R_FINITE(event_rate));
   return event_rate;
 }
 
+#define PENALTY_RATE                                    \
+  penalty_rate(__x,__p,__stateindex,__parindex,q)       \
+
+// penalty alone (cf. 'event_rates'),
+// where 'q' is the extra rate of the guided progression.
+static inline double penalty_rate
+(
+ double *__x,
+ const double *__p,
+ const int *__stateindex,
+ const int *__parindex,
+ double q
+ ) {
+  return ((I > ellI) ? 0 : gamma*I) + (psi+chi)*I - q;
+}
+
 //! Latent-state initializer (rinit component).
 //!
 //! The state variables include S, E, I, R
@@ -154,6 +188,8 @@ void seirs_gill
   double *color = &COLOR;
   const int nsample = *get_userdata_int("nsample");
   const int *nodetype = get_userdata_int("nodetype");
+  const int *group = get_userdata_int("group");
+  const int nnode = *get_userdata_int("nnode");
   const int *lineage = get_userdata_int("lineage");
   const int *sat = get_userdata_int("saturation");
   const int *index = get_userdata_int("index");
@@ -162,126 +198,255 @@ void seirs_gill
   int parent = (int) nearbyint(node);
 
 #ifndef NDEBUG
-  int nnode = *get_userdata_int("nnode");
   assert(parent>=0);
   assert(parent<=nnode);
 #endif
 
-  int parlin = lineage[parent];
-  int parcol = color[parlin];
-  assert(parlin >= 0 && parlin < nsample);
-
   ll = 0;
 
-  // singular portion of filter equation
-  switch (nodetype[parent]) {
-  default:                      // non-genealogical event #nocov
-    break;                      // #nocov
-  case 0:                       // root
-    // color lineages by sampling without replacement
-    assert(sat[parent]==1);
-    int c = child[index[parent]];
-    assert(lineage[parent]==lineage[c]);
-    if (E-ellE + I-ellI > 0) {
-      double x = (E-ellE)/(E-ellE + I-ellI);
-      if (unif_rand() < x) {      // lineage is put into E deme
-        color[lineage[c]] = Exposed;
-        ellE += 1;
-        ll -= log(x);
-      } else {                    // lineage is put into I deme
-        color[lineage[c]] = Infected;
-        ellI += 1;
-        ll -= log(1-x);
+  // singular portion of filter equation,
+  // at each of the simultaneous nodes of the group
+  do {
+    int parlin = lineage[parent];
+    int parcol = color[parlin];
+    assert(parlin >= 0 && parlin < nsample);
+
+    switch (nodetype[parent]) {
+    default:                    // non-genealogical event #nocov
+      break;                    // #nocov
+    case 0:                     // root
+      // color lineages by sampling without replacement
+      assert(sat[parent]==1);
+      int c = child[index[parent]];
+      assert(lineage[parent]==lineage[c]);
+      if (E-ellE + I-ellI > 0) {
+        double x = (E-ellE)/(E-ellE + I-ellI);
+        if (unif_rand() < x) {    // lineage is put into E deme
+          color[lineage[c]] = Exposed;
+          ellE += 1;
+          ll -= log(x);
+        } else {                  // lineage is put into I deme
+          color[lineage[c]] = Infected;
+          ellI += 1;
+          ll -= log(1-x);
+        }
+      } else {              // more roots than infectives
+        ll += R_NegInf;     // this is incompatible with the genealogy
+        // the following keeps the state valid
+        if (unif_rand() < 0.5) {  // lineage is put into E deme
+          color[lineage[c]] = Exposed;
+          ellE += 1; E += 1;
+          //        ll -= log(0.5);
+        } else {                // lineage is put into I deme
+          color[lineage[c]] = Infected;
+          ellI += 1; I += 1;
+          //        ll -= log(0.5);
+        }
+      }
+      break;
+    case 1:                     // sample
+      // If parent is not in deme I, likelihood = 0.
+      if (parcol != Infected) {
+        ll += R_NegInf;
+        color[parlin] = Infected;
+        // the following keeps the state valid
+        ellE -= 1; ellI += 1;
+        E -= 1; I += 1;
       }
-    } else {                // more roots than infectives
-      ll += R_NegInf;       // this is incompatible with the genealogy
-      // the following keeps the state valid
-      if (unif_rand() < 0.5) {  // lineage is put into E deme
-        color[lineage[c]] = Exposed;
-        ellE += 1; E += 1;
-        //        ll -= log(0.5);
-      } else {                  // lineage is put into I deme
+      if (sat[parent] == 1) {   // s=(0,1)
+        int c = child[index[parent]];
         color[lineage[c]] = Infected;
-        ellI += 1; I += 1;
-        //        ll -= log(0.5);
+        ll += log(psi);
+      } else if (sat[parent] == 0) { // s=(0,0)
+        ellI -= 1;
+        ll += log(psi+chi);
+        if (psi+chi <= 0)
+          ll += R_NegInf;
+        else if (unif_rand() < psi/(psi+chi)) { // non-destructive sample
+          ll += log(I-ellI);
+        } else {                // destructive sample
+          ll += log(I);
+          I -= 1;
+        }
+      } else {
+        assert(0);              // #nocov
+        ll += R_NegInf;         // #nocov
       }
-    }
-    break;
-  case 1:                       // sample
-    // If parent is not in deme I, likelihood = 0.
-    if (parcol != Infected) {
-      ll += R_NegInf;
-      color[parlin] = Infected;
-      // the following keeps the state valid
-      ellE -= 1; ellI += 1;
-      E -= 1; I += 1;
-    }
-    if (sat[parent] == 1) {     // s=(0,1)
-      int c = child[index[parent]];
-      color[lineage[c]] = Infected;
-      ll += log(psi);
-    } else if (sat[parent] == 0) { // s=(0,0)
-      ellI -= 1;
-      ll += log(psi+chi);
-      if (psi+chi <= 0)
-	ll += R_NegInf;
-      else if (unif_rand() < psi/(psi+chi)) { // non-destructive sample
-        ll += log(I-ellI);
-      } else {                  // destructive sample
-        ll += log(I);
-        I -= 1;
+      color[parlin] = R_NaReal;
+      break;
+    case 2:                     // branch point s=(1,1)
+      // If parent is not in deme I, likelihood = 0.
+      if (parcol != Infected) {
+        ll += R_NegInf;
+        color[parlin] = Infected;
+        // the following keeps the state valid
+        ellE -= 1; ellI += 1;
+        E -= 1; I += 1;
       }
-    } else {
-      assert(0);                // #nocov
-      ll += R_NegInf;           // #nocov
-    }
-    color[parlin] = R_NaReal;
-    break;
-  case 2:                       // branch point s=(1,1)
-    // If parent is not in deme I, likelihood = 0.
-    if (parcol != Infected) {
-      ll += R_NegInf;
-      color[parlin] = Infected;
-      // the following keeps the state valid
-      ellE -= 1; ellI += 1;
-      E -= 1; I += 1;
-    }
-    assert(sat[parent]==2);
-    ll += (S > 0 && I > 0) ? log(Beta*S/POP/(E+1)) : R_NegInf;
-    S -= 1; E += 1;
-    ellE += 1;
-    S = (S > 0) ? S : 0;
-    int c1 = child[index[parent]];
-    int c2 = child[index[parent]+1];
-    assert(c1 != c2);
-    assert(lineage[c1] != lineage[c2]);
-    assert(lineage[c1] != parlin || lineage[c2] != parlin);
-    assert(lineage[c1] == parlin || lineage[c2] == parlin);
-    if (unif_rand() < 0.5) {
-      color[lineage[c1]] = Exposed;
-      color[lineage[c2]] = Infected;
-    } else {
-      color[lineage[c1]] = Infected;
-      color[lineage[c2]] = Exposed;
+      assert(sat[parent]==2);
+      ll += (S > 0 && I > 0) ? log(Beta*S/POP/(E+1)) : R_NegInf;
+      S -= 1; E += 1;
+      ellE += 1;
+      S = (S > 0) ? S : 0;
+      int c1 = child[index[parent]];
+      int c2 = child[index[parent]+1];
+      assert(c1 != c2);
+      assert(lineage[c1] != lineage[c2]);
+      assert(lineage[c1] != parlin || lineage[c2] != parlin);
+      assert(lineage[c1] == parlin || lineage[c2] == parlin);
+      if (unif_rand() < 0.5) {
+        color[lineage[c1]] = Exposed;
+        color[lineage[c2]] = Infected;
+      } else {
+        color[lineage[c1]] = Infected;
+        color[lineage[c2]] = Exposed;
+      }
+      ll -= log(0.5);
+      break;
     }
-    ll -= log(0.5);
-    break;
-  }
+  } while (++parent < nnode && group[parent] == group[parent-1]);
 
   // continuous portion of filter equation:
-  // take Gillespie steps to the end of the interval
+  // take Gillespie steps to the end of the interval,
+  // or, if tau > 0, tau leaps where these are safe,
+  // or, if thin, uniformized steps
   if (tmax > t && R_FINITE(ll)) {
 
     double rate[nrate], logpi[nrate];
     int event;
     double event_rate = 0;
     double penalty = 0;
+    const double tau = *get_userdata_double("tau");
+    const int thin = *get_userdata_int("thin");
+    // if guided, the lineage of the next node, which must then lie in deme I
+    const int guide = *get_userdata_int("guide");
+    int glin = (guide && parent < nnode && nodetype[parent] > 0) ?
+      lineage[parent] : -1;
+    double glog = 0;
+    // bounding rates of transmission, progression, recovery, waning,
+    // and guided progression, for uniformized steps (cf. 'thin_span')
+    double bound[5], lambda = 0, span = 0, q = 0;
 
     event_rate = EVENT_RATES;
-    tstep = exp_rand()/event_rate;
 
-    while (t + tstep < tmax) {
-      event = rcateg(event_rate,rate,nrate);
+    while (t < tmax) {
+      event = -1;
+      tstep = 0;
+      if (thin && tau <= 0) {
+        if (span <= 0) {
+          if (glin >= 0 && nearbyint(color[glin]) == Exposed) {
+            q = guide_rate(sigma,dt,&glog);
+          } else {
+            q = 0; glog = 0;
+          }
+          double alpha = (POP > 0) ? Beta*S*I/POP : 0;
+          double slope = (POP > 0) ? Beta*(S+I)/POP : 0;
+          span = thin_span(alpha+sigma*E+gamma*I+omega*R,
+                           slope+sigma+gamma+omega);
+          lambda = 0;
+          lambda += (bound[0] = (POP > 0) ? Beta*(S+span)*(I+span)/POP : 0);
+          lambda += (bound[1] = sigma*(E+span));
+          lambda += (bound[2] = gamma*(I+span));
+          lambda += (bound[3] = omega*(R+span));
+          lambda += (bound[4] = q);
+        }
+        penalty = PENALTY_RATE;
+        // draw candidates until one is accepted
+        do {
+          double alpha, pi, u;
+          tstep += exp_rand()/lambda;
+          if (t + tstep >= tmax) break;
+          switch (thin_categ(lambda,bound,5,&u)) {
+          case 0:               // transmission
+            alpha = Beta*S*I/POP;
+            if (u < alpha) {
+              pi = 1-ellI/I;
+              if (u < alpha*pi) {
+                event = 0; logpi[0] = log(pi);
+              } else {
+                event = 1; logpi[1] = log(1-pi)-log(ellI);
+              }
+            }
+            break;
+          case 1:               // progression
+            alpha = sigma*E;
+            if (u < alpha) {
+              pi = 1-ellE/E;
+              if (u < alpha*pi) {
+                event = 2; logpi[2] = log(pi);
+              } else {
+                event = 3; logpi[3] = log(1-pi)-log(ellE);
+              }
+            }
+            break;
+          case 2:               // recovery
+            if (I > ellI && u < gamma*I) {
+              event = 4; logpi[4] = 0;
+            }
+            break;
+          case 3:               // waning
+            if (u < omega*R) {
+              event = 5; logpi[5] = 0;
+            }
+            break;
+          default:              // guided progression
+            if (u < q) {
+              event = 6; logpi[6] = -log(E);
+            }
+            break;
+          }
+        } while (event < 0);
+        if (event < 0) break;
+        // the bounds are renewed when they lapse or a lineage moves
+        span = (lineage_event[event]) ? 0 : span-1;
+      } else if (tau > 0) {
+        double h = (tmax - t < tau) ? tmax - t : tau;
+        h = leap_bound(h,S,rate[5],rate[0]);
+        h = leap_bound(h,E-ellE,rate[0],rate[2]);
+        h = leap_bound(h,I-ellI,rate[2],rate[4]);
+        h = leap_bound(h,R,rate[4],rate[5]);
+        if (event_rate*h >= leap_min) {
+          // events that move lineages are not leapt over:
+          // the leap stops at the first of them.
+          double lrate[nrate];
+          double tl = exp_rand()/masked_rates(rate,lineage_event,lrate,nrate);
+          if (tl < h) h = tl;
+          double x0[5] = {S, E, I, R, ll};
+          double k[nrate];
+          // rates, and weights of the events, at the expected midpoint
+          S += nearbyint(0.5*h*(rate[5]-rate[0]));
+          E += nearbyint(0.5*h*(rate[0]-rate[2]));
+          I += nearbyint(0.5*h*(rate[2]-rate[4]));
+          R += nearbyint(0.5*h*(rate[4]-rate[5]));
+          EVENT_RATES;
+          for (int e = 0; e < nrate; e++)
+            k[e] = (lineage_event[e]) ? 0 : leap_count(rate[e],h);
+          if (k[0] > 0) ll += k[0]*(log(1-ellE/(E+1))-logpi[0]);
+          if (k[2] > 0) ll += k[2]*(log(1-ellI/(I+1))-logpi[2]);
+          ll -= penalty*h;
+          S = x0[0] + k[5] - k[0];
+          E = x0[1] + k[0] - k[2];
+          I = x0[2] + k[2] - k[4];
+          R = x0[3] + k[4] - k[5];
+          if (S >= 0 && E >= ellE && I >= ellI && R >= 0) {
+            t = (h < tmax - t) ? t + h : tmax;
+            event_rate = EVENT_RATES;
+            if (h < tl) continue;
+            double lr = masked_rates(rate,lineage_event,lrate,nrate);
+            if (!(lr > 0)) continue;
+            event = rcateg(lr,lrate,nrate);
+          } else {
+            // the leap overshot: take an exact step
+            S = x0[0]; E = x0[1]; I = x0[2]; R = x0[3]; ll = x0[4];
+            event_rate = EVENT_RATES;
+          }
+        }
+      }
+      if (event < 0) {
+        tstep = exp_rand()/event_rate;
+        if (t + tstep >= tmax) break;
+        event = rcateg(event_rate,rate,nrate);
+      }
       assert(event>=0 && event<nrate);
       ll -= penalty*tstep + logpi[event];
       switch (event) {
@@ -308,6 +473,7 @@ void seirs_gill
       case 3:                   // progression, s=(0,1)
         assert(E>=1);
         change_color(color,nsample,random_choice(ellE),Exposed,Infected);
+        if (glin >= 0 && nearbyint(color[glin]) == Infected) ll += glog;
         ellE -= 1; ellI += 1;
         E -= 1; I += 1;
         ll -= log(I);
@@ -323,6 +489,14 @@ void seirs_gill
         R -= 1; S += 1;
         assert(!ISNAN(ll));
         break;
+      case 6:                   // guided progression, s=(0,1)
+        assert(E>=1);
+        color[glin] = Infected;
+        ellE -= 1; ellI += 1;
+        E -= 1; I += 1;
+        ll += glog-log(I);
+        assert(!ISNAN(ll));
+        break;
       default:                  // #nocov
         assert(0);              // #nocov
         ll += R_NegInf;         // #nocov
@@ -333,14 +507,16 @@ void seirs_gill
       ellI = nearbyint(ellI);
 
       t += tstep;
-      event_rate = EVENT_RATES;
-      tstep = exp_rand()/event_rate;
+      if (!thin || tau > 0) event_rate = EVENT_RATES;
 
     }
     tstep = tmax - t;
     ll -= penalty*tstep;
+    // a lineage left outside deme I cannot give rise to the next node:
+    // the particle is discarded now, rather than after resampling.
+    if (glin >= 0 && nearbyint(color[glin]) != Infected) ll += R_NegInf;
   }
-  node += 1;
+  node = parent;
 }
 
 # define lik  (__lik[0])
@@ -5,6 +5,8 @@
 #define High 2
 
 static const int nrate = 10;
+// events that move a lineage between demes
+static const int lineage_event[] = {0, 0, 1, 0, 1, 0, 1, 0, 0, 0};
 
 static inline int random_choice (double n) {
   return floor(R_unif_index(n));
@@ -193,6 +195,8 @@ void si2rs_gill
   double *color = &COLOR;
   const int nsample = *get_userdata_int("nsample");
   const int *nodetype = get_userdata_int("nodetype");
+  const int *group = get_userdata_int("group");
+  const int nnode = *get_userdata_int("nnode");
   const int *lineage = get_userdata_int("lineage");
   const int *index = get_userdata_int("index");
   const int *child = get_userdata_int("child");
@@ -201,123 +205,177 @@ void si2rs_gill
 
 #ifndef NDEBUG
   const int *sat = get_userdata_int("saturation");
-  int nnode = *get_userdata_int("nnode");
   assert(parent>=0);
   assert(parent<=nnode);
 #endif
 
-  int parlin = lineage[parent];
-  int parcol = color[parlin];
-  assert(parlin >= 0 && parlin < nsample);
-
   ll = 0;
 
-  // singular portion of filter equation
-  switch (nodetype[parent]) {
-  default:                      // non-genealogical event #nocov
-    break;                      // #nocov
-  case 0:                       // root
-    // color lineages by sampling without replacement
-    assert(sat[parent]==1);
-    int c = child[index[parent]];
-    assert(lineage[parent]==lineage[c]);
-    if (IL-ellL + IH-ellH > 0) {
-      double x = (IL-ellL)/(IL-ellL + IH-ellH);
-      if (unif_rand() < x) {      // lineage is put into Low deme
+  // singular portion of filter equation,
+  // at each of the simultaneous nodes of the group
+  do {
+    int parlin = lineage[parent];
+    int parcol = color[parlin];
+    assert(parlin >= 0 && parlin < nsample);
+
+    switch (nodetype[parent]) {
+    default:                    // non-genealogical event #nocov
+      break;                    // #nocov
+    case 0:                     // root
+      // color lineages by sampling without replacement
+      assert(sat[parent]==1);
+      int c = child[index[parent]];
+      assert(lineage[parent]==lineage[c]);
+      if (IL-ellL + IH-ellH > 0) {
+        double x = (IL-ellL)/(IL-ellL + IH-ellH);
+        if (unif_rand() < x) {    // lineage is put into Low deme
+          color[lineage[c]] = Low;
+          ellL += 1;
+          ll -= log(x);
+        } else {                  // lineage is put into High deme
+          color[lineage[c]] = High;
+          ellH += 1;
+          ll -= log(1-x);
+        }
+        assert(!ISNAN(ll));
+      } else {              // more roots than infectives
+        ll += R_NegInf;     // this is incompatible with the genealogy
+        // the following keeps the state valid
         color[lineage[c]] = Low;
-        ellL += 1;
-        ll -= log(x);
-      } else {                    // lineage is put into High deme
-        color[lineage[c]] = High;
-        ellH += 1;
-        ll -= log(1-x);
+        ellL += 1; IL += 1;
       }
-      assert(!ISNAN(ll));
-    } else {                // more roots than infectives
-      ll += R_NegInf;       // this is incompatible with the genealogy
-      // the following keeps the state valid
-      color[lineage[c]] = Low;
-      ellL += 1; IL += 1;
-    }
-    break;
-  case 1:                       // sample
-    assert(sat[parent]==0);
-    if (parcol == Low) {
-      assert(ellL>=1 && IL >= ellL);
-      ll += log(chi*IL);
-      ellL -= 1; IL -= 1;
-    } else if (parcol == High) {
-      assert(ellH>=1 && IH >= ellH);
-      ll += log(chi*IH);
-      ellH -= 1; IH -= 1;
-    } else {
-      assert(0);                // #nocov
-    }
-    color[parlin] = R_NaReal;
-    break;
-  case 2:
-    assert(sat[parent]==2);
-    int c1 = child[index[parent]];
-    int c2 = child[index[parent]+1];
-    assert(c1 != c2);
-    assert(lineage[c1] != lineage[c2]);
-    assert(lineage[c1] != parlin || lineage[c2] != parlin);
-    assert(lineage[c1] == parlin || lineage[c2] == parlin);
-    if (parcol == Low) {
-      assert(ellL >= 1 && IL >= ellL);
-      if (S >= 1 && POP > 0) {
-        ll += log(Beta*S*IL/POP);
-        S -= 1; IL += 1;
-        ellL += 1;
-        color[lineage[c1]] = Low;
-        color[lineage[c2]] = Low;
+      break;
+    case 1:                     // sample
+      assert(sat[parent]==0);
+      if (parcol == Low) {
+        assert(ellL>=1 && IL >= ellL);
+        ll += log(chi*IL);
+        ellL -= 1; IL -= 1;
+      } else if (parcol == High) {
+        assert(ellH>=1 && IH >= ellH);
+        ll += log(chi*IH);
+        ellH -= 1; IH -= 1;
       } else {
-        ll += R_NegInf;
-        IL += 1; ellL += 1;
-        color[lineage[c1]] = Low;
-        color[lineage[c2]] = Low;
+        assert(0);              // #nocov
       }
-    } else if (parcol == High) {
-      assert(ellH >= 1 && IH >= ellH);
-      if (S>=1 && POP > 0) {
-        ll += log(kappa*Beta*S*IH/POP);
-        S -= 1; IL += 1;
-        ellL += 1;
-        if (unif_rand() < 0.5) {
+      color[parlin] = R_NaReal;
+      break;
+    case 2:
+      assert(sat[parent]==2);
+      int c1 = child[index[parent]];
+      int c2 = child[index[parent]+1];
+      assert(c1 != c2);
+      assert(lineage[c1] != lineage[c2]);
+      assert(lineage[c1] != parlin || lineage[c2] != parlin);
+      assert(lineage[c1] == parlin || lineage[c2] == parlin);
+      if (parcol == Low) {
+        assert(ellL >= 1 && IL >= ellL);
+        if (S >= 1 && POP > 0) {
+          ll += log(Beta*S*IL/POP);
+          S -= 1; IL += 1;
+          ellL += 1;
           color[lineage[c1]] = Low;
-          color[lineage[c2]] = High;
+          color[lineage[c2]] = Low;
         } else {
-          color[lineage[c1]] = High;
+          ll += R_NegInf;
+          IL += 1; ellL += 1;
+          color[lineage[c1]] = Low;
           color[lineage[c2]] = Low;
         }
-        ll -= log(0.5);
-        assert(!ISNAN(ll));
+      } else if (parcol == High) {
+        assert(ellH >= 1 && IH >= ellH);
+        if (S>=1 && POP > 0) {
+          ll += log(kappa*Beta*S*IH/POP);
+          S -= 1; IL += 1;
+          ellL += 1;
+          if (unif_rand() < 0.5) {
+            color[lineage[c1]] = Low;
+            color[lineage[c2]] = High;
+          } else {
+            color[lineage[c1]] = High;
+            color[lineage[c2]] = Low;
+          }
+          ll -= log(0.5);
+          assert(!ISNAN(ll));
+        } else {
+          ll += R_NegInf;
+          IL += 1; ellL += 1;
+          color[lineage[c1]] = Low;
+          color[lineage[c2]] = High;
+        }
       } else {
-        ll += R_NegInf;
-        IL += 1; ellL += 1;
-        color[lineage[c1]] = Low;
-        color[lineage[c2]] = High;
+        assert(0);              // #nocov
       }
-    } else {
-      assert(0);                // #nocov
+      break;
     }
-    break;
-  }
+  } while (++parent < nnode && group[parent] == group[parent-1]);
 
   // continuous portion of filter equation:
-  // take Gillespie steps to the end of the interval
+  // take Gillespie steps to the end of the interval,
+  // or, if tau > 0, tau leaps where these are safe
   if (tmax > t && R_FINITE(ll)) {
 
     double rate[nrate], logpi[nrate];
     int event;
     double event_rate = 0;
     double decay = 0;
+    const double tau = *get_userdata_double("tau");
 
     event_rate = EVENT_RATES;
-    tstep = exp_rand()/event_rate;
 
-    while (t + tstep < tmax) {
-      event = rcateg(event_rate,rate,nrate);
+    while (t < tmax) {
+      event = -1;
+      tstep = 0;
+      if (tau > 0) {
+        double h = (tmax - t < tau) ? tmax - t : tau;
+        h = leap_bound(h,S,rate[9],rate[0]+rate[1]);
+        h = leap_bound(h,IL-ellL,rate[0]+rate[1]+rate[5],rate[3]+rate[7]);
+        h = leap_bound(h,IH-ellH,rate[3],rate[5]+rate[8]);
+        h = leap_bound(h,R,rate[7]+rate[8],rate[9]);
+        if (event_rate*h >= leap_min) {
+          // events that move lineages are not leapt over:
+          // the leap stops at the first of them.
+          double lrate[nrate];
+          double tl = exp_rand()/masked_rates(rate,lineage_event,lrate,nrate);
+          if (tl < h) h = tl;
+          double x0[5] = {S, IL, IH, R, ll};
+          double k[nrate];
+          // rates, and weights of the events, at the expected midpoint
+          S += nearbyint(0.5*h*(rate[9]-rate[0]-rate[1]));
+          IL += nearbyint(0.5*h*(rate[0]+rate[1]+rate[5]-rate[3]-rate[7]));
+          IH += nearbyint(0.5*h*(rate[3]-rate[5]-rate[8]));
+          R += nearbyint(0.5*h*(rate[7]+rate[8]-rate[9]));
+          EVENT_RATES;
+          for (int e = 0; e < nrate; e++)
+            k[e] = (lineage_event[e]) ? 0 : leap_count(rate[e],h);
+          if (k[0] > 0) ll += k[0]*(log(1-ellL*(ellL-1)/(IL+1)/IL)-logpi[0]);
+          if (k[1] > 0) ll += k[1]*(log(1-ellL/(IL+1))-logpi[1]);
+          if (k[3] > 0) ll += k[3]*(log(1-ellH/(IH+1))-logpi[3]);
+          if (k[5] > 0) ll += k[5]*(log(1-ellL/(IL+1))-logpi[5]);
+          ll -= decay*h;
+          S = x0[0] + k[9] - k[0] - k[1];
+          IL = x0[1] + k[0] + k[1] + k[5] - k[3] - k[7];
+          IH = x0[2] + k[3] - k[5] - k[8];
+          R = x0[3] + k[7] + k[8] - k[9];
+          if (S >= 0 && IL >= ellL && IH >= ellH && R >= 0) {
+            t = (h < tmax - t) ? t + h : tmax;
+            event_rate = EVENT_RATES;
+            if (h < tl) continue;
+            double lr = masked_rates(rate,lineage_event,lrate,nrate);
+            if (!(lr > 0)) continue;
+            event = rcateg(lr,lrate,nrate);
+          } else {
+            // the leap overshot: take an exact step
+            S = x0[0]; IL = x0[1]; IH = x0[2]; R = x0[3]; ll = x0[4];
+            event_rate = EVENT_RATES;
+          }
+        }
+      }
+      if (event < 0) {
+        tstep = exp_rand()/event_rate;
+        if (t + tstep >= tmax) break;
+        event = rcateg(event_rate,rate,nrate);
+      }
       assert(event>=0 && event<nrate);
       ll -= decay*tstep + logpi[event];
       switch (event) {
@@ -385,13 +443,12 @@ void si2rs_gill
 
       t += tstep;
       event_rate = EVENT_RATES;
-      tstep = exp_rand()/event_rate;
 
     }
     tstep = tmax - t;
     ll -= decay*tstep;
   }
-  node += 1;
+  node = parent;
 }
 
 # define lik  (__lik[0])
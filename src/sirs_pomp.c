@@ -65,6 +65,21 @@ static double event_rates
   return event_rate;
 }
 
+#define PENALTY_RATE                                    \
+  penalty_rate(__x,__p,__stateindex,__parindex)         \
+
+// penalty alone (cf. 'event_rates').
+static inline double penalty_rate
+(
+ double *__x,
+ const double *__p,
+ const int *__stateindex,
+ const int *__parindex
+ ) {
+  double disc = (I > 0) ? ellI*(ellI-1)/I/(I+1) : 1;
+  return Beta*S*I/POP*disc + ((I > ellI) ? 0 : gamma*I) + (psi+chi)*I;
+}
+
 //! Latent-state initializer (rinit).
 void sirs_rinit
 (
@@ -101,71 +116,144 @@ void sirs_gill
  ){
   double tstep = 0.0, tmax = t + dt;
   const int *nodetype = get_userdata_int("nodetype");
+  const int *group = get_userdata_int("group");
+  const int nnode = *get_userdata_int("nnode");
   const int *sat = get_userdata_int("saturation");
 
   int parent = (int) nearbyint(node);
 
 #ifndef NDEBUG
-  int nnode = *get_userdata_int("nnode");
   assert(parent>=0);
   assert(parent<=nnode);
 #endif
 
   ll = 0;
 
-  // singular portion of filter equation
-  switch (nodetype[parent]) {
-  default:                      // non-genealogical event #nocov
-    break;                      // #nocov
-  case 0:                       // root
-    ellI += 1;
-    break;
-  case 1:                       // sample
-    assert(I >= ellI);
-    assert(ellI >= 0);
-    if (sat[parent] == 1) {
-      ll += log(psi);
-    } else if (sat[parent] == 0) {
-      ellI -= 1;
-      ll += log(psi+chi);
-      if (psi+chi <= 0)
-	ll += R_NegInf;
-      else if (unif_rand() < psi/(psi+chi)) { // non-destructive sample
-	ll += log(I-ellI);
-      } else {			// destructive sample
-	ll += log(I);
-	I -= 1;
+  // singular portion of filter equation,
+  // at each of the simultaneous nodes of the group
+  do {
+    switch (nodetype[parent]) {
+    default:                    // non-genealogical event #nocov
+      break;                    // #nocov
+    case 0:                     // root
+      ellI += 1;
+      break;
+    case 1:                     // sample
+      assert(I >= ellI);
+      assert(ellI >= 0);
+      if (sat[parent] == 1) {
+        ll += log(psi);
+      } else if (sat[parent] == 0) {
+        ellI -= 1;
+        ll += log(psi+chi);
+        if (psi+chi <= 0)
+          ll += R_NegInf;
+        else if (unif_rand() < psi/(psi+chi)) { // non-destructive sample
+          ll += log(I-ellI);
+        } else {                // destructive sample
+          ll += log(I);
+          I -= 1;
+        }
+      } else {
+        assert(0);              // #nocov
+        ll += R_NegInf;         // #nocov
       }
-    } else {
-      assert(0);                // #nocov
-      ll += R_NegInf;           // #nocov
+      break;
+    case 2:                     // branch point s=(1,1)
+      assert(S >= 0);
+      assert(I >= 0);
+      assert(ellI > 0);
+      assert(sat[parent]==2);
+      ll += (I > 0 && I >= ellI) ? log(Beta*S*I/POP) : R_NegInf;
+      S -= 1; I += 1;
+      ellI += 1;
+      ll -= log(I*(I-1)/2);
+      S = (S > 0) ? S : 0;
+      break;
     }
-    break;
-  case 2:                       // branch point s=(1,1)
-    assert(S >= 0);
-    assert(I >= 0);
-    assert(ellI > 0);
-    assert(sat[parent]==2);
-    ll += (I > 0 && I >= ellI) ? log(Beta*S*I/POP) : R_NegInf;
-    S -= 1; I += 1;
-    ellI += 1;
-    ll -= log(I*(I-1)/2);
-    S = (S > 0) ? S : 0;
-    break;
-  }
+  } while (++parent < nnode && group[parent] == group[parent-1]);
 
   if (tmax > t) {
 
-    // take Gillespie steps to the end of the interval:
+    // take Gillespie steps to the end of the interval,
+    // or, if tau > 0, tau leaps where these are safe,
+    // or, if thin, uniformized steps:
     int event;
     double penalty = 0;
     double rate[nrate];
+    const double tau = *get_userdata_double("tau");
+    const int thin = *get_userdata_int("thin");
+    // bounding rates for uniformized steps (cf. 'thin_span')
+    double bound[nrate], lambda = 0, span = 0;
 
     double event_rate = EVENT_RATES;
-    tstep = exp_rand()/event_rate;
 
-    while (t + tstep < tmax) {
-      event = rcateg(event_rate,rate,nrate);
+    while (t < tmax) {
+      event = -1;
+      tstep = 0;
+      if (thin && tau <= 0) {
+        if (span <= 0) {
+          span = thin_span(Beta*S*I/POP+gamma*I+omega*R,
+                           Beta*(S+I)/POP+gamma+omega);
+          lambda = 0;
+          lambda += (bound[0] = Beta*(S+span)*(I+span)/POP);
+          lambda += (bound[1] = gamma*(I+span));
+          lambda += (bound[2] = omega*(R+span));
+        }
+        penalty = PENALTY_RATE;
+        // draw candidates until one is accepted
+        do {
+          double u, disc;
+          tstep += exp_rand()/lambda;
+          if (t + tstep >= tmax) break;
+          switch (thin_categ(lambda,bound,nrate,&u)) {
+          case 0:                 // transmission
+            disc = (I > 0) ? ellI*(ellI-1)/I/(I+1) : 1;
+            if (u < Beta*S*I/POP*(1-disc)) event = 0;
+            break;
+          case 1:                 // recovery
+            if (I > ellI && u < gamma*I) event = 1;
+            break;
+          default:                // loss of immunity
+            if (u < omega*R) event = 2;
+            break;
+          }
+        } while (event < 0);
+        if (event < 0) break;
+        span -= 1;
+      } else if (tau > 0) {
+        double h = (tmax - t < tau) ? tmax - t : tau;
+        h = leap_bound(h,S,rate[2],rate[0]);
+        h = leap_bound(h,I-ellI,rate[0],rate[1]);
+        h = leap_bound(h,R,rate[1],rate[2]);
+        if (event_rate*h >= leap_min) {
+          double x0[4] = {S, I, R, ll};
+          double k[nrate];
+          // rates at the expected midpoint of the leap
+          S += nearbyint(0.5*h*(rate[2]-rate[0]));
+          I += nearbyint(0.5*h*(rate[0]-rate[1]));
+          R += nearbyint(0.5*h*(rate[1]-rate[2]));
+          EVENT_RATES;
+          for (int e = 0; e < nrate; e++) k[e] = leap_count(rate[e],h);
+          ll -= penalty*h;
+          S = x0[0] + k[2] - k[0];
+          I = x0[1] + k[0] - k[1];
+          R = x0[2] + k[1] - k[2];
+          if (S >= 0 && I >= ellI && R >= 0) {
+            t = (h < tmax - t) ? t + h : tmax;
+            event_rate = EVENT_RATES;
+            continue;
+          }
+          // the leap overshot: take an exact step
+          S = x0[0]; I = x0[1]; R = x0[2]; ll = x0[3];
+          event_rate = EVENT_RATES;
+        }
+      }
+      if (event < 0) {
+        tstep = exp_rand()/event_rate;
+        if (t + tstep >= tmax) break;
+        event = rcateg(event_rate,rate,nrate);
+      }
       assert(event>=0 && event<nrate);
       ll -= penalty*tstep;
       switch (event) {
@@ -183,13 +271,12 @@ void sirs_gill
         break;                    // #nocov
       }
       t += tstep;
-      event_rate = EVENT_RATES;
-      tstep = exp_rand()/event_rate;
+      if (!thin || tau > 0) event_rate = EVENT_RATES;
     }
     tstep = tmax - t;
     ll -= penalty*tstep;
   }
-  node += 1;
+  node = parent;
 }
 
 # define lik  (__lik[0])
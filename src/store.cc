@@ -0,0 +1,108 @@
+// File-backed store of genealogies
+
+#include "store.h"
+#include "genealogy.h"
+#include "genview.h"
+#include "generics.h"
+#include "internal.h"
+
+static void store_finalize (SEXP Store) {
+  store_t *S = static_cast<store_t*>(R_ExternalPtrAddr(Store));
+  if (S != 0) {
+    delete S;
+    R_ClearExternalPtr(Store);
+  }
+}
+
+static store_t* get_store (SEXP Store) {
+  if (TYPEOF(Store) != EXTPTRSXP)
+    err("in %s: not a genealogy store.",__func__);
+  store_t *S = static_cast<store_t*>(R_ExternalPtrAddr(Store));
+  if (S == 0)
+    err("genealogy store is closed: reopen it with 'gpstore'.");
+  return S;
+}
+
+extern "C" {
+
+  //! open (or create) a genealogy store
+  SEXP storeOpen (SEXP File) {
+    SEXP out;
+    const char *file = CHAR(STRING_ELT(File,0));
+    store_t *S = new store_t;
+    store_t::status_t status = S->open(file);
+    int version = S->version();
+    if (status != store_t::opened) {
+      delete S;
+      switch (status) {
+      case store_t::cannot_open:
+        err("in %s: cannot open genealogy store '%s'.",__func__,file);
+        break;
+      case store_t::cannot_write: // #nocov
+        err("in %s: cannot write genealogy store '%s'.",__func__,file); // #nocov
+        break;                    // #nocov
+      case store_t::cannot_map:   // #nocov
+        err("in %s: cannot map genealogy store '%s'.",__func__,file); // #nocov
+        break;                    // #nocov
+      case store_t::bad_version:
+        err("in %s: unsupported genealogy store version (%d).",__func__,version);
+        break;
+      default:
+        err("in %s: '%s' is not a genealogy store.",__func__,file);
+        break;
+      }
+    }
+    PROTECT(out = R_MakeExternalPtr(S,R_NilValue,R_NilValue));
+    R_RegisterCFinalizerEx(out,store_finalize,TRUE);
+    if (S->truncated())
+      warn("in %s: an incomplete genealogy at the end of store '%s' has been discarded.",
+           __func__,file);
+    UNPROTECT(1);
+    return out;
+  }
+
+  //! number of genealogies in the store
+  SEXP storeLength (SEXP Store) {
+    return ScalarInteger(int(get_store(Store)->length()));
+  }
+
+  //! append genealogies to the store.
+  //! only the genealogy is written,
+  //! even if the object holds the state of a process.
+  SEXP storeAppend (SEXP Store, SEXP Objects) {
+    store_t *S = get_store(Store);
+    int n = LENGTH(Objects);
+    SEXP ids;
+    PROTECT(ids = NEW_INTEGER(n));
+    for (int k = 0; k < n; k++) {
+      SEXP x = VECTOR_ELT(Objects,k);
+      if (genview_t::readable(x)) {
+        genview_t V = x;
+        S->append(RAW(x),V.bytesize());
+      } else {
+        SEXP G;
+        PROTECT(G = serial(genealogy_t(x)));
+        S->append(RAW(G),LENGTH(G));
+        UNPROTECT(1);
+      }
+      INTEGER(ids)[k] = int(S->length());
+    }
+    UNPROTECT(1);
+    return ids;
+  }
+
+  //! retrieve a genealogy by its (1-based) id
+  SEXP storeGet (SEXP Store, SEXP Id) {
+    store_t *S = get_store(Store);
+    int i = *INTEGER(AS_INTEGER(Id));
+    if (i == NA_INTEGER || i < 1 || size_t(i) > S->length())
+      err("no genealogy with id %d in store.",i);
+    SEXP out;
+    PROTECT(out = NEW_RAW(S->bytesize(i-1)));
+    S->get(i-1,RAW(out));
+    SET_ATTR(out,install("class"),mkString("gpgen"));
+    UNPROTECT(1);
+    return out;
+  }
+
+}
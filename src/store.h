@@ -0,0 +1,254 @@
+// -*- C++ -*-
+// STORE class
+
+#ifndef _STORE_H_
+#define _STORE_H_
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if defined(_WIN32)
+#include <io.h>
+#define STORE_NO_MMAP
+#define store_fseek _fseeki64
+#define store_ftell _ftelli64
+#define store_truncate(F,N) (_chsize_s(_fileno(F),(N)) == 0)
+#else
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+#define store_fseek fseeko
+#define store_ftell ftello
+#define store_truncate(F,N) (ftruncate(fileno(F),off_t(N)) == 0)
+#endif
+
+#include "internal.h"
+
+//! A file-backed store of serialized genealogies.
+
+//! The file begins with an 8-byte signature.
+//! It is followed by the genealogies, each written as its length
+//! (8 bytes, least-significant byte first) and its serialization.
+//! The store is append-only.
+//! On opening, a single pass over the length prefixes builds the
+//! offset index, which gives random access to the genealogies.
+//! An incomplete record at the end of the file
+//! (as left by an interrupted append) is discarded.
+//! Where the platform allows, the file is memory-mapped, so that
+//! genealogies are paged in only when they are read;
+//! otherwise (on Windows), each is read from the file on demand.
+class store_t {
+
+private:
+
+  //! Signature of the file: the last byte is the format version.
+  static constexpr raw_t header[8] = {'P','G','S','T','O','R','E',1};
+
+  //! The file.
+  FILE *_file;
+  //! Current size of the file.
+  size_t _size;
+  //! Offsets of the genealogies (just past their length prefixes).
+  std::vector<size_t> _off;
+  //! Lengths of the genealogies.
+  std::vector<size_t> _len;
+  //! Format version found in the file.
+  int _version;
+  //! Was an incomplete record discarded on opening?
+  bool _truncated;
+#ifndef STORE_NO_MMAP
+  //! The memory-mapped file.
+  raw_t *_map;
+  //! Size of the mapped region.
+  size_t _mapsize;
+#endif
+
+private:
+
+  //! map (or re-map) the whole file.
+  //! returns false if this fails.
+  bool map (void) {
+#ifndef STORE_NO_MMAP
+    unmap();
+    void *m = mmap(0,_size,PROT_READ,MAP_SHARED,fileno(_file),0);
+    if (m == MAP_FAILED) return false; // #nocov
+    _map = static_cast<raw_t*>(m);
+    _mapsize = _size;
+#endif
+    return true;
+  };
+  //! release the mapping
+  void unmap (void) {
+#ifndef STORE_NO_MMAP
+    if (_map != 0) munmap(_map,_mapsize);
+    _map = 0;
+    _mapsize = 0;
+#endif
+  };
+  //! copy n bytes at offset 'off' in the file into o
+  void read (raw_t *o, size_t off, size_t n) {
+#ifndef STORE_NO_MMAP
+    if (off+n > _mapsize && !map())
+      err("in %s: cannot map genealogy store.",__func__); // #nocov
+    memcpy(o,_map+off,n);
+#else
+    if (store_fseek(_file,off,SEEK_SET) != 0 ||
+        fread(o,1,n,_file) != n)
+      err("in %s: cannot read genealogy store.",__func__); // #nocov
+#endif
+  };
+  //! build the offset index.
+  //! returns the end of the last complete record.
+  size_t index (void) {
+    _off.clear();
+    _len.clear();
+    size_t off = sizeof(header);
+    while (off+8 <= _size) {
+      raw_t b[8];
+      read(b,off,sizeof(b));
+      size_t n = 0;
+      for (int k = 7; k >= 0; k--) n = (n << 8) | b[k];
+      if (n > _size-off-sizeof(b)) break;
+      off += sizeof(b);
+      _off.push_back(off);
+      _len.push_back(n);
+      off += n;
+    }
+    return off;
+  };
+  //! release the file
+  void close (void) {
+    unmap();
+    if (_file != 0) fclose(_file);
+    _file = 0;
+  };
+
+public:
+
+  //! outcome of opening a store
+  typedef enum {
+    opened = 0,
+    cannot_open,
+    cannot_write,
+    cannot_map,
+    not_a_store,
+    bad_version
+  } status_t;
+
+  // CONSTRUCTORS
+  //! a store not yet opened
+  store_t (void) {
+    _file = 0;
+    _size = 0;
+    _version = 0;
+    _truncated = false;
+#ifndef STORE_NO_MMAP
+    _map = 0;
+    _mapsize = 0;
+#endif
+  };
+  //! open the store in the named file, creating it if need be.
+  //! no error is raised: on failure, the file is released
+  //! and the reason is returned, so that the caller can
+  //! dispose of the store before reporting it.
+  status_t open (const char *file) {
+    close();
+    _file = fopen(file,"a+b");
+    if (_file == 0) return cannot_open;
+    store_fseek(_file,0,SEEK_END);
+    _size = size_t(store_ftell(_file));
+    if (_size == 0) {
+      if (fwrite(header,1,sizeof(header),_file) != sizeof(header) ||
+          fflush(_file) != 0) {
+        close();                // #nocov
+        return cannot_write;    // #nocov
+      }
+      _size = sizeof(header);
+    }
+    if (_size < sizeof(header)) {
+      close();
+      return not_a_store;
+    }
+    if (!map()) {
+      close();                  // #nocov
+      return cannot_map;        // #nocov
+    }
+    raw_t h[sizeof(header)];
+    read(h,0,sizeof(h));
+    _version = int(h[7]);
+    if (memcmp(h,header,sizeof(header)-1) != 0) {
+      close();
+      return not_a_store;
+    }
+    if (h[7] != header[7]) {
+      close();
+      return bad_version;
+    }
+    size_t end = index();
+    _truncated = (end < _size);
+    if (_truncated) {
+      unmap();
+      if (!store_truncate(_file,end)) {
+        close();                // #nocov
+        return cannot_write;    // #nocov
+      }
+      _size = end;
+      if (!map()) {
+        close();                // #nocov
+        return cannot_map;      // #nocov
+      }
+    }
+    return opened;
+  };
+  //! copy constructor
+  store_t (const store_t&) = delete;
+  //! copy assignment operator
+  store_t& operator= (const store_t&) = delete;
+  //! destructor
+  ~store_t (void) {
+    close();
+  };
+
+public:
+
+  //! format version found in the file
+  int version (void) const {
+    return _version;
+  };
+  //! was an incomplete record discarded on opening?
+  bool truncated (void) const {
+    return _truncated;
+  };
+  //! number of genealogies in the store
+  size_t length (void) const {
+    return _off.size();
+  };
+  //! length of the serialization of genealogy i (0-based)
+  size_t bytesize (size_t i) const {
+    return _len[i];
+  };
+  //! copy genealogy i (0-based) into o
+  void get (size_t i, raw_t *o) {
+    read(o,_off[i],_len[i]);
+  };
+  //! append a serialized genealogy of n bytes
+  void append (const raw_t *x, size_t n) {
+    raw_t b[8];
+    size_t m = n;
+    for (int k = 0; k < 8; k++) {
+      b[k] = raw_t(m & 0xff);
+      m >>= 8;
+    }
+    store_fseek(_file,0,SEEK_END);
+    if (fwrite(b,1,sizeof(b),_file) != sizeof(b) ||
+        fwrite(x,1,n,_file) != n || fflush(_file) != 0)
+      err("in %s: cannot write genealogy store.",__func__); // #nocov
+    _off.push_back(_size+sizeof(b));
+    _len.push_back(n);
+    _size += sizeof(b)+n;
+  };
+
+};
+
+#endif
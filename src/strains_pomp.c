@@ -146,109 +146,150 @@ void strains_gill
  ){
   double tstep = 0.0, tmax = t + dt;
   const int *nodetype = get_userdata_int("nodetype");
+  const int *group = get_userdata_int("group");
+  const int nnode = *get_userdata_int("nnode");
   const int *sat = get_userdata_int("saturation");
   const int *deme = get_userdata_int("deme");
   const int *index = get_userdata_int("index");
   const int *child = get_userdata_int("child");
 
   int parent = (int) nearbyint(node);
-  int c = child[index[parent]];
 
 #ifndef NDEBUG
   const int *lineage = get_userdata_int("lineage");
-  int nnode = *get_userdata_int("nnode");
   assert(parent>=0);
   assert(parent<=nnode);
 #endif
 
   ll = 0;
 
-  // singular portion of filter equation
-  switch (nodetype[parent]) {
-  default:                      // non-genealogical event #nocov
-    break;                      // #nocov
-  case 0:                       // root
-    assert(sat[parent]==1);
-    assert(lineage[parent]==lineage[c]);
-    switch (deme[c]) {
-    case STRAIN1:
-      ellI1 += 1; break;
-    case STRAIN2:
-      ellI2 += 1; break;
-    case STRAIN3:
-      ellI3 += 1; break;
-    default:                    // #nocov
-      assert(0); break;         // #nocov
-    }
-    break;
-  case 1:                       // sample
-    assert(sat[parent]==0);
-    switch (deme[parent]) {
-    case STRAIN1:
-      assert(I1 >= ellI1);
-      assert(ellI1 >= 0);
-      ll += log(chi*I1);
-      ellI1 -= 1; I1 -= 1;
-      break;
-    case STRAIN2:
-      assert(I2 >= ellI2);
-      assert(ellI2 >= 0);
-      ll += log(chi*I2);
-      ellI2 -= 1; I2 -= 1;
-      break;
-    case STRAIN3:
-      assert(I3 >= ellI3);
-      assert(ellI3 >= 0);
-      ll += log(chi*I3);
-      ellI3 -= 1; I3 -= 1;
-      break;
-    default:                    // #nocov
-      assert(0); break;         // #nocov
-    }
-    break;
-  case 2:                       // branch point s=(1,1)
-    assert(S >= 0);
-    if (sat[parent]!=2) break;
-    switch (deme[parent]) {
-    case STRAIN1:
-      assert(I1 >= 0);
-      assert(ellI1 > 0);
-      ll += (I1 > 0 && I1 >= ellI1) ? log(Beta1*S*I1/POP) : R_NegInf;
-      S -= 1; I1 += 1; ellI1 += 1;
-      ll -= log(I1*(I1-1)/2);
+  // singular portion of filter equation,
+  // at each of the simultaneous nodes of the group
+  do {
+    int c = child[index[parent]];
+
+    switch (nodetype[parent]) {
+    default:                    // non-genealogical event #nocov
+      break;                    // #nocov
+    case 0:                     // root
+      assert(sat[parent]==1);
+      assert(lineage[parent]==lineage[c]);
+      switch (deme[c]) {
+      case STRAIN1:
+        ellI1 += 1; break;
+      case STRAIN2:
+        ellI2 += 1; break;
+      case STRAIN3:
+        ellI3 += 1; break;
+      default:                  // #nocov
+        assert(0); break;       // #nocov
+      }
       break;
-    case STRAIN2:
-      assert(I2 >= 0);
-      assert(ellI2 > 0);
-      ll += (I2 > 0 && I2 >= ellI2) ? log(Beta2*S*I2/POP) : R_NegInf;
-      S -= 1; I2 += 1; ellI2 += 1;
-      ll -= log(I2*(I2-1)/2);
+    case 1:                     // sample
+      assert(sat[parent]==0);
+      switch (deme[parent]) {
+      case STRAIN1:
+        assert(I1 >= ellI1);
+        assert(ellI1 >= 0);
+        ll += log(chi*I1);
+        ellI1 -= 1; I1 -= 1;
+        break;
+      case STRAIN2:
+        assert(I2 >= ellI2);
+        assert(ellI2 >= 0);
+        ll += log(chi*I2);
+        ellI2 -= 1; I2 -= 1;
+        break;
+      case STRAIN3:
+        assert(I3 >= ellI3);
+        assert(ellI3 >= 0);
+        ll += log(chi*I3);
+        ellI3 -= 1; I3 -= 1;
+        break;
+      default:                  // #nocov
+        assert(0); break;       // #nocov
+      }
       break;
-    case STRAIN3:
-      assert(I3 >= 0);
-      assert(ellI3 > 0);
-      ll += (I3 > 0 && I3 >= ellI3) ? log(Beta3*S*I3/POP) : R_NegInf;
-      S -= 1; I3 += 1; ellI3 += 1;
-      ll -= log(I3*(I3-1)/2);
+    case 2:                     // branch point s=(1,1)
+      assert(S >= 0);
+      if (sat[parent]!=2) break;
+      switch (deme[parent]) {
+      case STRAIN1:
+        assert(I1 >= 0);
+        assert(ellI1 > 0);
+        ll += (I1 > 0 && I1 >= ellI1) ? log(Beta1*S*I1/POP) : R_NegInf;
+        S -= 1; I1 += 1; ellI1 += 1;
+        ll -= log(I1*(I1-1)/2);
+        break;
+      case STRAIN2:
+        assert(I2 >= 0);
+        assert(ellI2 > 0);
+        ll += (I2 > 0 && I2 >= ellI2) ? log(Beta2*S*I2/POP) : R_NegInf;
+        S -= 1; I2 += 1; ellI2 += 1;
+        ll -= log(I2*(I2-1)/2);
+        break;
+      case STRAIN3:
+        assert(I3 >= 0);
+        assert(ellI3 > 0);
+        ll += (I3 > 0 && I3 >= ellI3) ? log(Beta3*S*I3/POP) : R_NegInf;
+        S -= 1; I3 += 1; ellI3 += 1;
+        ll -= log(I3*(I3-1)/2);
+        break;
+      default:                  // #nocov
+        assert(0); break;       // #nocov
+      }
+      S = (S > 0) ? S : 0;
       break;
-    default:                    // #nocov
-      assert(0); break;         // #nocov
     }
-    S = (S > 0) ? S : 0;
-    break;
-  }
+  } while (++parent < nnode && group[parent] == group[parent-1]);
 
   if (tmax > t && R_FINITE(ll)) {
 
-    // take Gillespie steps to the end of the interval:
+    // take Gillespie steps to the end of the interval,
+    // or, if tau > 0, tau leaps where these are safe:
     int event;
     double penalty = 0;
     double rate[nrate], logpi[nrate];
+    const double tau = *get_userdata_double("tau");
 
     double event_rate = EVENT_RATES;
-    tstep = exp_rand()/event_rate;
 
-    while (t + tstep < tmax) {
+    while (t < tmax) {
+      if (tau > 0) {
+        double h = (tmax - t < tau) ? tmax - t : tau;
+        h = leap_bound(h,S,0,rate[0]+rate[2]+rate[4]);
+        h = leap_bound(h,I1-ellI1,rate[0],rate[1]);
+        h = leap_bound(h,I2-ellI2,rate[2],rate[3]);
+        h = leap_bound(h,I3-ellI3,rate[4],rate[5]);
+        if (event_rate*h >= leap_min) {
+          double x0[6] = {S, I1, I2, I3, R, ll};
+          double k[nrate];
+          // rates at the expected midpoint of the leap
+          S -= nearbyint(0.5*h*(rate[0]+rate[2]+rate[4]));
+          I1 += nearbyint(0.5*h*(rate[0]-rate[1]));
+          I2 += nearbyint(0.5*h*(rate[2]-rate[3]));
+          I3 += nearbyint(0.5*h*(rate[4]-rate[5]));
+          EVENT_RATES;
+          for (int e = 0; e < nrate; e++) k[e] = leap_count(rate[e],h);
+          ll -= penalty*h;
+          S = x0[0] - k[0] - k[2] - k[4];
+          I1 = x0[1] + k[0] - k[1];
+          I2 = x0[2] + k[2] - k[3];
+          I3 = x0[3] + k[4] - k[5];
+          R = x0[4] + k[1] + k[3] + k[5];
+          if (S >= 0 && I1 >= ellI1 && I2 >= ellI2 && I3 >= ellI3) {
+            t = (h < tmax - t) ? t + h : tmax;
+            event_rate = EVENT_RATES;
+            continue;
+          }
+          // the leap overshot: take an exact step
+          S = x0[0]; I1 = x0[1]; I2 = x0[2]; I3 = x0[3]; R = x0[4];
+          ll = x0[5];
+          event_rate = EVENT_RATES;
+        }
+      }
+      tstep = exp_rand()/event_rate;
+      if (t + tstep >= tmax) break;
       event = rcateg(event_rate,rate,nrate);
       assert(event>=0 && event<nrate);
       ll -= penalty*tstep + logpi[event];
@@ -276,12 +317,11 @@ void strains_gill
       }
       t += tstep;
       event_rate = EVENT_RATES;
-      tstep = exp_rand()/event_rate;
     }
     tstep = tmax - t;
     ll -= penalty*tstep;
   }
-  node += 1;
+  node = parent;
 }
 
 # define lik  (__lik[0])
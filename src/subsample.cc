@@ -0,0 +1,102 @@
+// Random subsampling of genealogies
+
+#include "genealogy.h"
+#include "cache.h"
+#include "generics.h"
+#include "internal.h"
+#include <vector>
+
+//! choose, uniformly at random and without replacement,
+//! m of the candidates in c, and mark them in keep.
+static void
+choose
+(const std::vector<size_t>& c, size_t m, std::vector<bool>& keep)
+{
+  if (m > c.size()) m = c.size();
+  std::vector<int> s(m);
+  random_sample_wo_repl(s.data(),int(c.size()),int(m));
+  for (int i : s) keep[c[i]] = true;
+}
+
+extern "C" {
+
+  //! independent random subsamples of one genealogy.
+  //! only samples with times in the window are eligible.
+  //! if Prob is not NA, each eligible sample is kept independently
+  //! with that probability;
+  //! otherwise, if Size is not NA, Size eligible samples are kept,
+  //! or, if Size has more than one element, Size[d-1] of those in deme d;
+  //! otherwise, all eligible samples are kept.
+  //! the genealogy is decoded just once:
+  //! each subsample is thinned from a copy.
+  SEXP subsample (SEXP State, SEXP Prob, SEXP Size, SEXP Window, SEXP Nsim) {
+    const genealogy_t *G = genealogy_cache().fetch(State,0);
+    double prob = *REAL(AS_NUMERIC(Prob));
+    PROTECT(Size = AS_INTEGER(Size));
+    PROTECT(Window = AS_NUMERIC(Window));
+    size_t nsize = LENGTH(Size);
+    const int *size = INTEGER(Size);
+    slate_t lo = REAL(Window)[0], hi = REAL(Window)[1];
+    int nsim = *INTEGER(AS_INTEGER(Nsim));
+    if (nsim == NA_INTEGER || nsim < 0)
+      err("in '%s': 'nsim' must be a non-negative integer.",__func__);
+    if (!ISNA(prob) && !(prob >= 0 && prob <= 1))
+      err("in '%s': 'prob' must lie in [0,1].",__func__);
+    for (size_t d = 0; d < nsize; d++) {
+      if (size[d] == NA_INTEGER && nsize == 1) break;
+      if (size[d] == NA_INTEGER || size[d] < 0)
+        err("in '%s': 'size' must be non-negative.",__func__);
+    }
+    if (nsize > 1 && nsize != G->ndeme())
+      err("in '%s': 'size' should have length 1 or %zu (the number of demes).",
+          __func__,G->ndeme());
+    bool quota = (nsize > 1 || (nsize == 1 && size[0] != NA_INTEGER));
+    // eligible samples, in order, by deme
+    size_t n = 0;
+    std::vector<size_t> elig, deme;
+    for (const node_t *p : *G) {
+      for (const ball_t *b : *p) {
+        if (b->is(blue)) {
+          if (p->slate >= lo && p->slate <= hi) {
+            elig.push_back(n);
+            deme.push_back(b->deme());
+          }
+          n++;
+        }
+      }
+    }
+    std::vector<std::vector<size_t>> cand(nsize);
+    SEXP out;
+    PROTECT(out = NEW_LIST(nsim));
+    GetRNGstate();
+    for (int k = 0; k < nsim; k++) {
+      std::vector<bool> keep(n,false);
+      if (!ISNA(prob)) {
+        for (size_t i : elig) keep[i] = (unif_rand() < prob);
+      } else if (quota && nsize > 1) {
+        for (auto& c : cand) c.clear();
+        for (size_t i = 0; i < elig.size(); i++) {
+          if (deme[i] >= 1 && deme[i] <= nsize)
+            cand[deme[i]-1].push_back(elig[i]);
+        }
+        for (size_t d = 0; d < nsize; d++)
+          choose(cand[d],size_t(size[d]),keep);
+      } else if (quota) {
+        choose(elig,size_t(size[0]),keep);
+      } else {
+        for (size_t i : elig) keep[i] = true;
+      }
+      genealogy_t A = *G;
+      A.thin(keep);
+      SEXP x;
+      PROTECT(x = serial(A));
+      SET_ATTR(x,install("class"),mkString("gpgen"));
+      SET_ELEMENT(out,k,x);
+      UNPROTECT(1);
+    }
+    PutRNGstate();
+    UNPROTECT(3);
+    return out;
+  }
+
+}
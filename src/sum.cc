@@ -3,6 +3,9 @@
 #include "generics.h"
 #include "internal.h"
 #include <Rinternals.h>
+#include <list>
+#include <queue>
+#include <vector>
 
 //! shifts name to avoid overlap
 void
@@ -43,6 +46,45 @@ genealogy_t::operator+=
   return *this;
 }
 
+//! merges genealogies, adjusting time, t0, and ndeme as needed.
+//! the names of each genealogy are shifted past those of its predecessors,
+//! so that nodes from distinct genealogies are ordered by time and name.
+//! the merge of the node sequences is done by a heap on their heads.
+genealogy_t&
+genealogy_t::absorb
+(std::vector<genealogy_t>& parts)
+{
+  std::vector<std::list<node_t*>*> seq;
+  std::list<node_t*> own;
+  own.splice(own.end(),*this);
+  seq.push_back(&own);
+  for (genealogy_t& G : parts) {
+    timezero() = (timezero() < G.timezero()) ? timezero() : G.timezero();
+    time() = (time() > G.time()) ? time() : G.time();
+    ndeme() = (ndeme() > G.ndeme()) ? ndeme() : G.ndeme();
+    G.reuniqify(_unique);
+    _unique = G._unique;
+    seq.push_back(&G);
+  }
+  // 'later(i,j)' iff the head of sequence i follows that of sequence j
+  auto later = [&seq](size_t i, size_t j) {
+    node_t *p = seq[i]->front(), *q = seq[j]->front();
+    return (p->slate > q->slate) ||
+      ((p->slate == q->slate) && (p->uniq > q->uniq));
+  };
+  std::priority_queue<size_t,std::vector<size_t>,decltype(later)> heap(later);
+  for (size_t i = 0; i < seq.size(); i++) {
+    if (!seq[i]->empty()) heap.push(i);
+  }
+  while (!heap.empty()) {
+    size_t i = heap.top();
+    heap.pop();
+    splice(end(),*seq[i],seq[i]->begin());
+    if (!seq[i]->empty()) heap.push(i);
+  }
+  return *this;
+}
+
 extern "C" {
 
   //! combine genealogies
@@ -50,10 +92,13 @@ extern "C" {
     args = CDR(args);
     genealogy_t A(R_PosInf);    // a "null" genealogy
     A.time() = R_NegInf;
+    std::vector<genealogy_t> parts;
+    parts.reserve(Rf_length(args));
     while (args != R_NilValue) {
-      A += CAR(args);
+      parts.emplace_back(CAR(args));
       args = CDR(args);
     }
+    A.absorb(parts);
     SEXP S;
     PROTECT(S = serial(A));
     SET_ATTR(S,install("class"),mkString("gpgen"));
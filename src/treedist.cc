@@ -0,0 +1,337 @@
+// Distances between genealogies
+
+#include "genealogy.h"
+#include "cache.h"
+#include "genview.h"
+#include "internal.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+//! A tree with labelled tips.
+
+//! The tree is built from the dense form of a pruned, obscured genealogy
+//! (see nodeseq_t::dense), so that each parent precedes its children.
+//! Each sample is a tip, labelled by its position among the samples,
+//! which is the number given to its lineage by trace_lineages.
+//! Tips of different genealogies are thus matched by their labels.
+//! A sample held by a node that also has descendants,
+//! or by a node holding several samples,
+//! becomes a tip at the end of a zero-length branch (cf. insert_zlb).
+typedef struct {
+  //! parent of each node (the node itself for roots)
+  std::vector<size_t> par;
+  //! time of each node
+  std::vector<slate_t> tm;
+  //! label of each tip (-1 for other nodes)
+  std::vector<long> lab;
+  //! initial time
+  slate_t t0;
+  //! number of tips
+  size_t ntip;
+} ltree_t;
+
+//! build the labelled tree from the dense form of a genealogy
+static void
+label_tips
+(
+ ltree_t& T,
+ const std::vector<size_t>& par,
+ const std::vector<slate_t>& tm,
+ const std::vector<int>& nblue,
+ slate_t t0
+ )
+{
+  size_t n = par.size();
+  std::vector<int> nkid(n,0);
+  for (size_t i = 0; i < n; i++) {
+    if (par[i] != i) nkid[par[i]]++;
+  }
+  T.par = par;
+  T.tm = tm;
+  T.lab.assign(n,-1);
+  T.t0 = t0;
+  long k = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (nkid[i] == 0 && nblue[i] == 1) {
+      T.lab[i] = k++;
+    } else {
+      for (int j = 0; j < nblue[i]; j++) {
+        T.par.push_back(i);
+        T.tm.push_back(tm[i]);
+        T.lab.push_back(k++);
+      }
+    }
+  }
+  T.ntip = size_t(k);
+}
+
+//! hash key of a tip label
+static uint64_t
+tip_key
+(long x)
+{
+  uint64_t z = uint64_t(x)+0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27))*0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+//! clusters (sets of two or more, but not all, tips descended from a node).
+//! each is represented by the sum of the hash keys of its tips.
+static void
+clusters
+(const ltree_t& T, std::unordered_set<uint64_t>& C)
+{
+  size_t n = T.par.size();
+  std::vector<uint64_t> h(n,0);
+  std::vector<size_t> m(n,0);
+  C.clear();
+  for (size_t i = n; i-- > 0; ) {
+    if (T.lab[i] >= 0) {
+      h[i] += tip_key(T.lab[i]);
+      m[i]++;
+    }
+    if (m[i] >= 2 && m[i] < T.ntip) C.insert(h[i]);
+    if (T.par[i] != i) {
+      h[T.par[i]] += h[i];
+      m[T.par[i]] += m[i];
+    }
+  }
+}
+
+//! Robinson-Foulds distance: the number of clusters found in one tree
+//! but not in the other.
+static double
+rf_dist
+(const std::unordered_set<uint64_t>& A, const std::unordered_set<uint64_t>& B)
+{
+  size_t shared = 0;
+  for (uint64_t h : A) {
+    if (B.count(h) > 0) shared++;
+  }
+  return double(A.size()+B.size()-2*shared);
+}
+
+//! visit the entries of the Kendall-Colijn vector,
+//! (1-lambda)*m + lambda*M, calling f(index,value) for each.
+//! for tips i < j, m is the number of edges, and M the time,
+//! from the root to their most recent common ancestor;
+//! for each tip, m = 1 and M is the length of its pendant edge.
+//! roots are joined at a virtual root, at the initial time.
+//! each entry is visited exactly once.
+template <class F>
+static void
+kc_visit
+(const ltree_t& T, double lambda, F f)
+{
+  size_t n = T.par.size(), N = T.ntip;
+  size_t npair = N*(N-1)/2;
+  std::vector<size_t> ntip(n,0), start(n,0), depth(n,0), perm(N);
+  std::vector<size_t> first(n+1,0), kid(n), roots;
+  for (size_t i = n; i-- > 0; ) {
+    if (T.lab[i] >= 0) ntip[i]++;
+    if (T.par[i] != i) ntip[T.par[i]] += ntip[i];
+  }
+  // children of node i are kid[first[i]], ..., kid[first[i+1]-1]
+  for (size_t i = 0; i < n; i++) {
+    if (T.par[i] != i) first[T.par[i]+1]++;
+    else roots.push_back(i);
+  }
+  for (size_t i = 0; i < n; i++) first[i+1] += first[i];
+  std::vector<size_t> fill(first.begin(),first.end()-1);
+  for (size_t i = 0; i < n; i++) {
+    if (T.par[i] != i) kid[fill[T.par[i]]++] = i;
+  }
+  // the tips descended from each node occupy a contiguous range of perm.
+  // tips have no children.
+  std::vector<size_t> next(n,0);
+  size_t cursor = 0;
+  for (size_t i = 0; i < n; i++) {
+    size_t p = T.par[i];
+    if (p == i) {
+      start[i] = cursor;
+      cursor += ntip[i];
+      depth[i] = 1;
+    } else {
+      start[i] = next[p];
+      next[p] += ntip[i];
+      depth[i] = depth[p]+1;
+    }
+    next[i] = start[i];
+    if (T.lab[i] >= 0) {
+      perm[start[i]] = size_t(T.lab[i]);
+      f(npair+size_t(T.lab[i]),
+        (1-lambda)+lambda*(T.tm[i]-T.tm[p]));
+    }
+  }
+  auto pairs = [&] (size_t a, size_t na, size_t b, size_t nb, double v) {
+    for (size_t x = a; x < a+na; x++) {
+      for (size_t y = b; y < b+nb; y++) {
+        size_t i = perm[x], j = perm[y];
+        if (i > j) std::swap(i,j);
+        f(i*N-i*(i+1)/2+(j-i-1),v);
+      }
+    }
+  };
+  for (size_t i = 0; i < n; i++) {
+    double v = (1-lambda)*double(depth[i])+lambda*(T.tm[i]-T.t0);
+    for (size_t k = first[i]; k < first[i+1]; k++) {
+      size_t c = kid[k];
+      for (size_t l = first[i]; l < k; l++) {
+        size_t d = kid[l];
+        pairs(start[d],ntip[d],start[c],ntip[c],v);
+      }
+    }
+  }
+  for (size_t k = 0; k < roots.size(); k++) {
+    for (size_t l = 0; l < k; l++) {
+      size_t c = roots[k], d = roots[l];
+      pairs(start[d],ntip[d],start[c],ntip[c],0);
+    }
+  }
+}
+
+//! lineages through time, as a step function:
+//! n[k] lineages on [t[k],t[k+1]).
+//! a branch is counted at its upper, but not at its lower, end.
+static void
+ltt_steps
+(const ltree_t& T, std::vector<slate_t>& t, std::vector<double>& n)
+{
+  std::vector<std::pair<slate_t,int>> ev;
+  for (size_t i = 0; i < T.par.size(); i++) {
+    if (T.par[i] != i) {
+      ev.push_back({T.tm[T.par[i]],1});
+      ev.push_back({T.tm[i],-1});
+    }
+  }
+  std::sort(ev.begin(),ev.end());
+  t.clear(); n.clear();
+  double c = 0;
+  for (size_t k = 0; k < ev.size(); k++) {
+    c += ev[k].second;
+    if (k+1 == ev.size() || ev[k+1].first > ev[k].first) {
+      t.push_back(ev[k].first);
+      n.push_back(c);
+    }
+  }
+}
+
+//! L2 distance between two step functions
+static double
+ltt_dist
+(
+ const std::vector<slate_t>& t1, const std::vector<double>& n1,
+ const std::vector<slate_t>& t2, const std::vector<double>& n2
+ )
+{
+  double d = 0, a = 0, b = 0;
+  slate_t tcur = 0;
+  size_t i = 0, j = 0;
+  while (i < t1.size() || j < t2.size()) {
+    slate_t s = (j == t2.size() || (i < t1.size() && t1[i] < t2[j])) ?
+      t1[i] : t2[j];
+    if (i > 0 || j > 0) d += (a-b)*(a-b)*(s-tcur);
+    while (i < t1.size() && t1[i] == s) a = n1[i++];
+    while (j < t2.size() && t2[j] == s) b = n2[j++];
+    tcur = s;
+  }
+  return sqrt(d);
+}
+
+//! A reference genealogy, with which others are compared.
+typedef struct {
+  ltree_t tree;
+  std::unordered_set<uint64_t> clus;
+  std::vector<double> kc;
+  std::vector<slate_t> ltt_t;
+  std::vector<double> ltt_n;
+} ref_t;
+
+//! distances of tree T from the reference:
+//! Robinson-Foulds, Kendall-Colijn, and lineages-through-time L2.
+//! the first two are NA unless the trees have the same number of tips.
+static void
+tree_dist
+(const ref_t& R, const ltree_t& T, double lambda, double *d)
+{
+  std::vector<slate_t> t;
+  std::vector<double> n;
+  ltt_steps(T,t,n);
+  d[2] = ltt_dist(R.ltt_t,R.ltt_n,t,n);
+  if (T.ntip != R.tree.ntip) {
+    d[0] = d[1] = R_NaReal;
+    return;
+  }
+  std::unordered_set<uint64_t> C;
+  clusters(T,C);
+  d[0] = rf_dist(R.clus,C);
+  double s = 0;
+  kc_visit(T,lambda,[&] (size_t k, double v) {
+    s += (R.kc[k]-v)*(R.kc[k]-v);
+  });
+  d[1] = sqrt(s);
+}
+
+//! labelled tree of a pruned, obscured genealogy
+template <class TYPE>
+static void
+labelled_tree
+(const TYPE& A, ltree_t& T)
+{
+  std::vector<size_t> par;
+  std::vector<slate_t> tm;
+  std::vector<int> nblue;
+  A.dense(par,tm,nblue);
+  label_tips(T,par,tm,nblue,A.timezero());
+}
+
+extern "C" {
+
+  //! distances from one genealogy to each of a list of others,
+  //! in a matrix with one row per genealogy of the list.
+  //! the columns hold the Robinson-Foulds, Kendall-Colijn,
+  //! and lineages-through-time L2 distances.
+  //! as in 'cblv_array', the list is read in place, in chunks,
+  //! and the distances are computed in parallel.
+  SEXP treedist (SEXP Object, SEXP Others, SEXP Lambda, SEXP Nthreads) {
+    const char *colnames[] = {"rf","kc","ltt"};
+    double lambda = *REAL(AS_NUMERIC(Lambda));
+    if (!(lambda >= 0 && lambda <= 1))
+      err("in '%s': 'lambda' must lie in [0,1].",__func__);
+    int nthreads = *INTEGER(AS_INTEGER(Nthreads));
+    if (nthreads == NA_INTEGER || nthreads < 1) nthreads = 1;
+    ref_t R;
+    with_genealogy(Object,pre_prune|pre_obscure,
+                   [&] (const auto& A) {labelled_tree(A,R.tree);});
+    clusters(R.tree,R.clus);
+    size_t N = R.tree.ntip;
+    R.kc.assign(N*(N-1)/2+N,0);
+    kc_visit(R.tree,lambda,[&] (size_t k, double v) {R.kc[k] = v;});
+    ltt_steps(R.tree,R.ltt_t,R.ltt_n);
+    size_t n = LENGTH(Others);
+    SEXP out, dimnm, nm;
+    PROTECT(out = Rf_allocMatrix(REALSXP,n,3));
+    PROTECT(dimnm = NEW_LIST(2));
+    PROTECT(nm = NEW_CHARACTER(3));
+    for (int k = 0; k < 3; k++) SET_STRING_ELT(nm,k,mkChar(colnames[k]));
+    SET_ELEMENT(dimnm,0,R_NilValue);
+    SET_ELEMENT(dimnm,1,nm);
+    SET_DIMNAMES(out,dimnm);
+    double *x = REAL(out);
+    for_each_genealogy(Others,pre_prune|pre_obscure,nthreads,
+                       [&] (size_t k, const auto& A) {
+                         ltree_t T;
+                         double d[3];
+                         labelled_tree(A,T);
+                         tree_dist(R,T,lambda,d);
+                         for (int i = 0; i < 3; i++) x[k+n*i] = d[i];
+                       });
+    UNPROTECT(3);
+    return out;
+  }
+
+}
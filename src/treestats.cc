@@ -0,0 +1,281 @@
+// Summary statistics of genealogies
+
+#include "genealogy.h"
+#include "cache.h"
+#include "genview.h"
+#include "internal.h"
+#include <algorithm>
+#include <vector>
+
+//! Statistics computed by 'treestats'.
+typedef enum {
+  ts_ntip, ts_height, ts_length, ts_sackin, ts_colless,
+  ts_cherries, ts_ltt, ts_terminal, ts_internal, ts_demes
+} tstat_t;
+
+static const char *tstat_names[] = {
+  "ntip", "height", "length", "sackin", "colless",
+  "cherries", "ltt", "terminal", "internal", "demes"
+};
+
+static const size_t n_tstat = sizeof(tstat_names)/sizeof(const char *);
+
+//! Statistics requested of 'treestats'.
+typedef struct {
+  //! the statistics, in the order requested
+  std::vector<size_t> stat;
+  //! times at which lineages are counted
+  std::vector<slate_t> grid;
+  //! probabilities of branch-length quantiles
+  std::vector<double> probs;
+} tsopts_t;
+
+//! quantile of sorted values (as R's default, type 7)
+static double
+quantile
+(const std::vector<slate_t>& x, double p)
+{
+  if (x.empty()) return R_NaReal;
+  double h = p*double(x.size()-1);
+  size_t k = size_t(h);
+  if (k+1 >= x.size()) return x.back();
+  return x[k]+(h-double(k))*(x[k+1]-x[k]);
+}
+
+//! statistics of a tree in dense form (see nodeseq_t::dense),
+//! in the order requested, all but the deme counts.
+//! each parent must precede its children.
+//! the tips are the nodes without children;
+//! a node is a branch point if it has two or more children.
+//! - ntip: number of tips
+//! - height: time from the earliest root to the latest tip
+//! - length: total branch length
+//! - sackin: sum over tips of the number of branch points ancestral to each
+//! - colless: sum over branch points of the difference between the
+//!   largest and smallest numbers of tips descended from any one child
+//! - cherries: number of nodes with exactly two children, both tips
+//! - ltt: number of branches spanning each grid time
+//!   (each branch includes its upper, but not its lower, end)
+//! - terminal, internal: quantiles of the lengths of branches
+//!   ending in tips and in other nodes, respectively
+static void
+tree_stats
+(
+ const std::vector<size_t>& par,
+ const std::vector<slate_t>& tm,
+ const tsopts_t& opt,
+ std::vector<double>& val
+ )
+{
+  size_t n = par.size();
+  std::vector<size_t> nkid(n,0), ntip(n,0), tipkid(n,0);
+  std::vector<size_t> kmax(n,0), kmin(n,0), depth(n,0);
+  for (size_t i = 0; i < n; i++) {
+    if (par[i] != i) nkid[par[i]]++;
+  }
+  // backward: tips descended from each node and from each of its children
+  for (size_t i = n; i-- > 0; ) {
+    if (nkid[i] == 0) ntip[i] = 1;
+    if (par[i] != i) {
+      size_t p = par[i];
+      if (ntip[p] == 0 || ntip[i] > kmax[p]) kmax[p] = ntip[i];
+      if (ntip[p] == 0 || ntip[i] < kmin[p]) kmin[p] = ntip[i];
+      ntip[p] += ntip[i];
+      if (nkid[i] == 0) tipkid[p]++;
+    }
+  }
+  // forward: depths and branch lengths
+  size_t tips = 0, sackin = 0, colless = 0, cherries = 0;
+  slate_t len = 0, troot = R_PosInf, ttip = R_NegInf;
+  std::vector<slate_t> term, intl, start, end;
+  for (size_t i = 0; i < n; i++) {
+    size_t p = par[i];
+    if (nkid[i] >= 2) colless += kmax[i]-kmin[i];
+    if (nkid[i] == 2 && tipkid[i] == 2) cherries++;
+    if (p == i) {
+      if (tm[i] < troot) troot = tm[i];
+    } else {
+      depth[i] = depth[p] + ((nkid[p] >= 2) ? 1 : 0);
+      len += tm[i]-tm[p];
+      start.push_back(tm[p]);
+      end.push_back(tm[i]);
+      if (nkid[i] == 0) term.push_back(tm[i]-tm[p]);
+      else intl.push_back(tm[i]-tm[p]);
+    }
+    if (nkid[i] == 0) {
+      tips++;
+      sackin += depth[i];
+      if (tm[i] > ttip) ttip = tm[i];
+    }
+  }
+  std::sort(start.begin(),start.end());
+  std::sort(end.begin(),end.end());
+  std::sort(term.begin(),term.end());
+  std::sort(intl.begin(),intl.end());
+  val.clear();
+  for (size_t s : opt.stat) {
+    switch (s) {
+    case ts_ntip:
+      val.push_back(double(tips));
+      break;
+    case ts_height:
+      val.push_back((tips > 0) ? ttip-troot : R_NaReal);
+      break;
+    case ts_length:
+      val.push_back(len);
+      break;
+    case ts_sackin:
+      val.push_back(double(sackin));
+      break;
+    case ts_colless:
+      val.push_back(double(colless));
+      break;
+    case ts_cherries:
+      val.push_back(double(cherries));
+      break;
+    case ts_ltt:
+      for (slate_t t : opt.grid) {
+        size_t a = std::upper_bound(start.begin(),start.end(),t)-start.begin();
+        size_t b = std::upper_bound(end.begin(),end.end(),t)-end.begin();
+        val.push_back(double(a-b));
+      }
+      break;
+    case ts_terminal:
+      for (double q : opt.probs) val.push_back(quantile(term,q));
+      break;
+    case ts_internal:
+      for (double q : opt.probs) val.push_back(quantile(intl,q));
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+extern "C" {
+
+  //! summary statistics of a list of genealogies,
+  //! in a matrix with one row per genealogy.
+  //! the statistics are computed on the pruned, obscured genealogy,
+  //! with zero-length branches inserted, so that each sample is a tip.
+  //! 'ltt' occupies one column per grid time,
+  //! 'terminal' and 'internal' one column per probability,
+  //! and 'demes' one column per deme.
+  //! as in 'cblv_array', genealogies are read in place, in chunks,
+  //! and summarized in parallel.
+  SEXP treestats (SEXP Objects, SEXP Stats, SEXP Grid, SEXP Probs,
+                  SEXP Nthreads) {
+    tsopts_t opt;
+    bool demes = false;
+    for (R_xlen_t k = 0; k < XLENGTH(Stats); k++) {
+      const char *s = CHAR(STRING_ELT(Stats,k));
+      size_t j;
+      for (j = 0; j < n_tstat; j++) {
+        if (strcmp(s,tstat_names[j]) == 0) break;
+      }
+      if (j == n_tstat)
+        err("in '%s': unrecognized statistic '%s'.",__func__,s);
+      if (j == ts_demes) demes = true;
+      opt.stat.push_back(j);
+    }
+    PROTECT(Grid = AS_NUMERIC(Grid));
+    PROTECT(Probs = AS_NUMERIC(Probs));
+    opt.grid.assign(REAL(Grid),REAL(Grid)+LENGTH(Grid));
+    opt.probs.assign(REAL(Probs),REAL(Probs)+LENGTH(Probs));
+    for (double q : opt.probs) {
+      if (!(q >= 0 && q <= 1))
+        err("in '%s': 'probs' must lie in [0,1].",__func__);
+    }
+    size_t n = LENGTH(Objects);
+    int nthreads = *INTEGER(AS_INTEGER(Nthreads));
+    if (nthreads == NA_INTEGER || nthreads < 1) nthreads = 1;
+    std::vector<std::vector<double>> val(n);
+    std::vector<std::vector<size_t>> nsamp(n);
+    if (demes)
+      for_each_genealogy(Objects,pre_prune,nthreads,
+                         [&] (size_t k, const auto& A) {
+                           A.nsample(nsamp[k]);
+                         });
+    for_each_genealogy(Objects,pre_prune|pre_obscure|pre_zlb,nthreads,
+                       [&] (size_t k, const auto& A) {
+                         std::vector<size_t> par;
+                         std::vector<slate_t> tm;
+                         A.dense(par,tm);
+                         tree_stats(par,tm,opt,val[k]);
+                       });
+    // demes are numbered from 1; samples in the undeme are not counted.
+    size_t nd = 0;
+    for (size_t i = 0; i < n; i++) {
+      if (nsamp[i].size() > nd+1) nd = nsamp[i].size()-1;
+    }
+    size_t ncol = 0;
+    for (size_t s : opt.stat) {
+      switch (s) {
+      case ts_ltt:
+        ncol += opt.grid.size();
+        break;
+      case ts_terminal: case ts_internal:
+        ncol += opt.probs.size();
+        break;
+      case ts_demes:
+        ncol += nd;
+        break;
+      default:
+        ncol++;
+        break;
+      }
+    }
+    SEXP out, dimnm, nm;
+    PROTECT(out = Rf_allocMatrix(REALSXP,n,ncol));
+    PROTECT(dimnm = NEW_LIST(2));
+    PROTECT(nm = NEW_CHARACTER(ncol));
+    char buf[64];
+    size_t k = 0;
+    for (size_t s : opt.stat) {
+      switch (s) {
+      case ts_ltt:
+        for (size_t j = 0; j < opt.grid.size(); j++) {
+          snprintf(buf,sizeof(buf),"ltt.%zu",j+1);
+          SET_STRING_ELT(nm,k++,mkChar(buf));
+        }
+        break;
+      case ts_terminal: case ts_internal:
+        for (double q : opt.probs) {
+          snprintf(buf,sizeof(buf),"%s.%g%%",tstat_names[s],100*q);
+          SET_STRING_ELT(nm,k++,mkChar(buf));
+        }
+        break;
+      case ts_demes:
+        for (size_t d = 1; d <= nd; d++) {
+          snprintf(buf,sizeof(buf),"deme.%zu",d);
+          SET_STRING_ELT(nm,k++,mkChar(buf));
+        }
+        break;
+      default:
+        SET_STRING_ELT(nm,k++,mkChar(tstat_names[s]));
+        break;
+      }
+    }
+    SET_ELEMENT(dimnm,0,R_NilValue);
+    SET_ELEMENT(dimnm,1,nm);
+    SET_DIMNAMES(out,dimnm);
+    double *x = REAL(out);
+    for (size_t i = 0; i < n; i++) {
+      size_t j = 0, v = 0;
+      for (size_t s : opt.stat) {
+        if (s == ts_demes) {
+          for (size_t d = 1; d <= nd; d++, j++)
+            x[i+n*j] = (d < nsamp[i].size()) ? double(nsamp[i][d]) : 0;
+        } else {
+          size_t w = (s == ts_ltt) ? opt.grid.size() :
+            (s == ts_terminal || s == ts_internal) ? opt.probs.size() : 1;
+          for (size_t l = 0; l < w; l++, j++, v++)
+            x[i+n*j] = val[i][v];
+        }
+      }
+    }
+    UNPROTECT(5);
+    return out;
+  }
+
+}
@@ -1,7 +1,11 @@
 #include "pomplink.h"
 #include "internal.h"
 
-static const int nrate = 18;
+static const int nrate = 19;
+// events that move a lineage between hosts
+static const int lineage_event[] = {
+  0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1
+};
 #define host1 1
 #define host2 2
 
@@ -77,7 +81,8 @@ static int check_color (double *color, int nsample,
 #define EVENT_RATES                                     \
   event_rates(__x,__p,t,                                \
               __stateindex,__parindex,__covindex,       \
-              __covars,rate,logpi,&penalty)             \
+              __covars,rate,logpi,&penalty,             \
+              glin,gdeme,dt,&glog)                      \
 
 // FIXME: At the moment, the following codes exclude the possibility of
 // importation of infection.
@@ -92,7 +97,11 @@ static double event_rates
  const double *__covars,
  double *rate,
  double *logpi,
- double *penalty
+ double *penalty,
+ int glin,
+ int gdeme,
+ double dt,
+ double *glog
  ) {
   double event_rate = 0;
   double alpha, pi, disc;
@@ -233,6 +242,24 @@ static double event_rates
   event_rate += (*rate = alpha); rate++;
   *logpi = 0; logpi++;
   assert(R_FINITE(event_rate));
+  // 18: guided move of lineage 'glin' into host 'gdeme' (cf. 'guide_rate'),
+  // by Trans_21, s = (0,1), or Trans_12, s = (1,0)
+  const double *color = &COLOR;
+  if (glin >= 0 && nearbyint(color[glin]) != gdeme) {
+    if (gdeme == host2) {
+      alpha = (N1 > 0) ? 0.5*Beta21*S2/N1 : 0;
+      *logpi = -log(2*I1);      // as for event 3
+    } else {
+      alpha = (N2 > 0) ? 0.5*Beta12*S1/N2 : 0;
+      *logpi = -log(2*I2);      // as for event 5
+    }
+    event_rate += (*rate = guide_rate(alpha,dt,glog));
+    *penalty -= *rate;
+  } else {
+    *rate = 0; *logpi = 0; *glog = 0;
+  }
+  rate++; logpi++;
+  assert(R_FINITE(event_rate));
   // Sample_1 (Q = 0) // NB: (1-C1)*psi1+C1*psi1 = psi1
   *penalty += psi1*I1;
   // Sample_2 (Q = 0) // NB: (1-C2)*psi2+C2*psi2 = psi2
@@ -240,6 +267,35 @@ static double event_rates
   return event_rate;
 }
 
+//! Change the state by k[e] events of each type e,
+//! except those that move lineages.
+//! If 'whole' is set, the changes are rounded to whole numbers.
+static void twospecies_apply
+(
+ double *__x,
+ const int *__stateindex,
+ const double *k,
+ int whole
+ ) {
+  double d[8] = {
+    k[8] + k[10] - k[0] - k[4] - k[12],     // S1
+    k[0] + k[4] - k[6] - k[13],             // I1
+    k[6] - k[8] - k[14],                    // R1
+    k[10] - k[12] - k[13] - k[14],          // N1
+    k[9] + k[11] - k[1] - k[2] - k[15],     // S2
+    k[1] + k[2] - k[7] - k[16],             // I2
+    k[7] - k[9] - k[17],                    // R2
+    k[11] - k[15] - k[16] - k[17]           // N2
+  };
+  if (whole) {
+    for (int i = 0; i < 8; i++) d[i] = nearbyint(d[i]);
+    d[3] = d[0] + d[1] + d[2];
+    d[7] = d[4] + d[5] + d[6];
+  }
+  S1 += d[0]; I1 += d[1]; R1 += d[2]; N1 += d[3];
+  S2 += d[4]; I2 += d[5]; R2 += d[6]; N2 += d[7];
+}
+
 //! Latent-state initializer (rinit component).
 //!
 //! The state variables include S, E, I, R
@@ -302,6 +358,8 @@ void twospecies_gill
   double *color = &COLOR;
   const int nsample = *get_userdata_int("nsample");
   const int *nodetype = get_userdata_int("nodetype");
+  const int *group = get_userdata_int("group");
+  const int nnode = *get_userdata_int("nnode");
   const int *nodedeme = get_userdata_int("deme");
   const int *lineage = get_userdata_int("lineage");
   const int *sat = get_userdata_int("saturation");
@@ -311,213 +369,277 @@ void twospecies_gill
   int parent = (int) nearbyint(node);
 
 #ifndef NDEBUG
-  int nnode = *get_userdata_int("nnode");
   assert(parent>=0);
   assert(parent<=nnode);
 #endif
 
-  int parlin = lineage[parent];
-  int parcol = color[parlin];
-  int deme = nodedeme[parent];
-  assert(parlin >= 0 && parlin < nsample);
-  assert(nearbyint(N1)==nearbyint(S1+I1+R1));
-  assert(nearbyint(N2)==nearbyint(S2+I2+R2));
-  assert(check_color(color,nsample,ell1,ell2));
-
   ll = 0;
 
-  // singular portion of filter equation
-  switch (nodetype[parent]) {
-  default:                      // non-genealogical event #nocov
-    break;                      // #nocov
-  case 0:                       // root
-    // color lineages by sampling without replacement
-    assert(sat[parent]==1);
-    int c = child[index[parent]];
-    assert(parlin==lineage[c]);
-    if (I1-ell1+I2-ell2 > 0) {
-      double x = (I1-ell1)/(I1-ell1 + I2-ell2);
-      if (unif_rand() < x) {    // lineage is put into I1 deme
-        color[lineage[c]] = host1;
-        ell1 += 1;
-        ll -= log(x);
-      } else {                  // lineage is put into I2 deme
-        color[lineage[c]] = host2;
-        ell2 += 1;
-        ll -= log(1-x);
-      }
-    } else {                // more roots than infectives
-      ll += R_NegInf;       // this is incompatible with the genealogy
-      // the following keeps the state valid
-      if (unif_rand() < 0.5) {  // lineage is put into I1 deme
-        color[lineage[c]] = host1;
-        ell1 += 1; I1 += 1; N1 += 1;
-      } else {                  // lineage is put into I2 deme
-        color[lineage[c]] = host2;
-        ell2 += 1; I2 += 1; N2 += 1;
-      }
-    }
+  // singular portion of filter equation,
+  // at each of the simultaneous nodes of the group
+  do {
+    int parlin = lineage[parent];
+    int parcol = color[parlin];
+    int deme = nodedeme[parent];
+    assert(parlin >= 0 && parlin < nsample);
     assert(nearbyint(N1)==nearbyint(S1+I1+R1));
     assert(nearbyint(N2)==nearbyint(S2+I2+R2));
     assert(check_color(color,nsample,ell1,ell2));
-    break;
-  case 1:                       // sample
-    if (parcol != deme) { // parent color does not match the observed deme
-      ll += R_NegInf;
-    }
-    if (sat[parent] == 0) {     // s=(0,0)
-      if (parcol == host1) {
-        ell1 -= 1;
-        if (C1 < 1 && unif_rand() > C1) {
-          ll += log(psi1*(I1-ell1));
-        } else {
-          ll += log(psi1*I1);
-          I1 -= 1; N1 -= 1;
+
+    switch (nodetype[parent]) {
+    default:                    // non-genealogical event #nocov
+      break;                    // #nocov
+    case 0:                     // root
+      // color lineages by sampling without replacement
+      assert(sat[parent]==1);
+      int c = child[index[parent]];
+      assert(parlin==lineage[c]);
+      if (I1-ell1+I2-ell2 > 0) {
+        double x = (I1-ell1)/(I1-ell1 + I2-ell2);
+        if (unif_rand() < x) {  // lineage is put into I1 deme
+          color[lineage[c]] = host1;
+          ell1 += 1;
+          ll -= log(x);
+        } else {                // lineage is put into I2 deme
+          color[lineage[c]] = host2;
+          ell2 += 1;
+          ll -= log(1-x);
         }
-      } else if (parcol == host2) {
-        ell2 -= 1;
-        if (C2 < 1 && unif_rand() > C2) {
-          ll += log(psi2*(I2-ell2));
-        } else {
-          ll += log(psi2*I2);
-          I2 -= 1; N2 -= 1;
+      } else {              // more roots than infectives
+        ll += R_NegInf;     // this is incompatible with the genealogy
+        // the following keeps the state valid
+        if (unif_rand() < 0.5) {  // lineage is put into I1 deme
+          color[lineage[c]] = host1;
+          ell1 += 1; I1 += 1; N1 += 1;
+        } else {                // lineage is put into I2 deme
+          color[lineage[c]] = host2;
+          ell2 += 1; I2 += 1; N2 += 1;
         }
-      } else {
-        assert(0);              // #nocov
-        ll += R_NegInf;         // #nocov
       }
-    } else if (sat[parent] == 1) {
-      int c = child[index[parent]];
-      color[lineage[c]] = parcol;
-      if (parcol==host1) {
-        ll += log(psi1*(1-C1)); // s=(1,0)
-      } else if (parcol==host2) {
-        ll += log(psi2*(1-C2)); // s=(0,1)
-      } else {
-        assert(0);              // #nocov
-        ll += R_NegInf;         // #nocov
+      assert(nearbyint(N1)==nearbyint(S1+I1+R1));
+      assert(nearbyint(N2)==nearbyint(S2+I2+R2));
+      assert(check_color(color,nsample,ell1,ell2));
+      break;
+    case 1:                     // sample
+      if (parcol != deme) { // parent color does not match the observed deme
+        ll += R_NegInf;
       }
-    } else {
-      assert(0);                // #nocov
-      ll += R_NegInf;           // #nocov
-    }
-    color[parlin] = R_NaReal;
-    assert(nearbyint(N1)==nearbyint(S1+I1+R1));
-    assert(nearbyint(N2)==nearbyint(S2+I2+R2));
-    assert(check_color(color,nsample,ell1,ell2));
-    break;
-  case 2:                       // branch point
-    assert(sat[parent]==2);
-    if (parcol == host1) {      // parent is in I1
-      assert(S1>=0 && S2 >=0 && I1>=ell1 && ell1>=0);
-      double lambda11 = Beta11*S1*I1/N1;
-      double lambda21 = Beta21*S2*I1/N1;
-      double lambda = lambda11+lambda21;
-      double x = (lambda > 0) ? lambda11/lambda : 0;
-      int c1 = child[index[parent]];
-      int c2 = child[index[parent]+1];
-      assert(c1 != c2);
-      assert(lineage[c1] != lineage[c2]);
-      assert(lineage[c1] != parlin || lineage[c2] != parlin);
-      assert(lineage[c1] == parlin || lineage[c2] == parlin);
-      if (unif_rand() < x) {    // s = (2,0)
-        color[lineage[c1]] = host1;
-        color[lineage[c2]] = host1;
-        if (S1 > 0) {
-          S1 -= 1; I1 += 1; ell1 += 1;
-          ll += log(lambda)-log(I1*(I1-1)/2);
+      if (sat[parent] == 0) {   // s=(0,0)
+        if (parcol == host1) {
+          ell1 -= 1;
+          if (C1 < 1 && unif_rand() > C1) {
+            ll += log(psi1*(I1-ell1));
+          } else {
+            ll += log(psi1*I1);
+            I1 -= 1; N1 -= 1;
+          }
+        } else if (parcol == host2) {
+          ell2 -= 1;
+          if (C2 < 1 && unif_rand() > C2) {
+            ll += log(psi2*(I2-ell2));
+          } else {
+            ll += log(psi2*I2);
+            I2 -= 1; N2 -= 1;
+          }
         } else {
-          // the genealogy is incompatible with the state.
-          // nevertheless, the state remains valid.
-          I1 += 1; N1 += 1; ell1 += 1; // #nocov
-          ll += R_NegInf;              // #nocov
+          assert(0);            // #nocov
+          ll += R_NegInf;       // #nocov
         }
-      } else {                  // s = (1,1)
-        if (unif_rand() < 0.5) {
-          color[lineage[c1]] = host1;
-          color[lineage[c2]] = host2;
+      } else if (sat[parent] == 1) {
+        int c = child[index[parent]];
+        color[lineage[c]] = parcol;
+        if (parcol==host1) {
+          ll += log(psi1*(1-C1)); // s=(1,0)
+        } else if (parcol==host2) {
+          ll += log(psi2*(1-C2)); // s=(0,1)
         } else {
-          color[lineage[c1]] = host2;
-          color[lineage[c2]] = host1;
-        }
-        ll -= log(0.5);
-        if (S2 > 0) {
-          S2 -= 1; I2 += 1; ell2 += 1;
-          ll += log(lambda)-log(I1*I2);
-        } else {
-          // the genealogy is incompatible with the state.
-          // nevertheless, the state remains valid.
-          I2 += 1; N2 += 1; ell2 += 1;
-          ll += R_NegInf;
+          assert(0);            // #nocov
+          ll += R_NegInf;       // #nocov
         }
+      } else {
+        assert(0);              // #nocov
+        ll += R_NegInf;         // #nocov
       }
-    } else if (parcol == host2) { // parent is in I2
-      assert(S1>=0 && S2 >=0 && I2>=ell2);
-      double lambda12 = Beta12*S1*I2/N2;
-      double lambda22 = Beta22*S2*I2/N2;
-      double lambda = lambda12+lambda22;
-      double x = (lambda > 0) ? lambda22/lambda : 0;
-      int c1 = child[index[parent]];
-      int c2 = child[index[parent]+1];
-      assert(c1 != c2);
-      assert(lineage[c1] != lineage[c2]);
-      assert(lineage[c1] != parlin || lineage[c2] != parlin);
-      assert(lineage[c1] == parlin || lineage[c2] == parlin);
-      if (unif_rand() < x) { // s = (0,2)
-        color[lineage[c1]] = host2;
-        color[lineage[c2]] = host2;
-        if (S2 > 0) {
-          S2 -= 1; I2 += 1; ell2 += 1;
-          ll += log(lambda)-log(I2*(I2-1)/2);
-        } else {
-          // the genealogy is incompatible with the state.
-          // nevertheless, the state remains valid.
-          I2 += 1; N2 += 1; ell2 += 1;
-          ll += R_NegInf;
-        }
-      } else {                  // s = (1,1)
-        if (unif_rand() < 0.5) {
+      color[parlin] = R_NaReal;
+      assert(nearbyint(N1)==nearbyint(S1+I1+R1));
+      assert(nearbyint(N2)==nearbyint(S2+I2+R2));
+      assert(check_color(color,nsample,ell1,ell2));
+      break;
+    case 2:                     // branch point
+      assert(sat[parent]==2);
+      if (parcol == host1) {    // parent is in I1
+        assert(S1>=0 && S2 >=0 && I1>=ell1 && ell1>=0);
+        double lambda11 = Beta11*S1*I1/N1;
+        double lambda21 = Beta21*S2*I1/N1;
+        double lambda = lambda11+lambda21;
+        double x = (lambda > 0) ? lambda11/lambda : 0;
+        int c1 = child[index[parent]];
+        int c2 = child[index[parent]+1];
+        assert(c1 != c2);
+        assert(lineage[c1] != lineage[c2]);
+        assert(lineage[c1] != parlin || lineage[c2] != parlin);
+        assert(lineage[c1] == parlin || lineage[c2] == parlin);
+        if (unif_rand() < x) {  // s = (2,0)
           color[lineage[c1]] = host1;
-          color[lineage[c2]] = host2;
-        } else {
-          color[lineage[c1]] = host2;
           color[lineage[c2]] = host1;
+          if (S1 > 0) {
+            S1 -= 1; I1 += 1; ell1 += 1;
+            ll += log(lambda)-log(I1*(I1-1)/2);
+          } else {
+            // the genealogy is incompatible with the state.
+            // nevertheless, the state remains valid.
+            I1 += 1; N1 += 1; ell1 += 1; // #nocov
+            ll += R_NegInf;            // #nocov
+          }
+        } else {                // s = (1,1)
+          if (unif_rand() < 0.5) {
+            color[lineage[c1]] = host1;
+            color[lineage[c2]] = host2;
+          } else {
+            color[lineage[c1]] = host2;
+            color[lineage[c2]] = host1;
+          }
+          ll -= log(0.5);
+          if (S2 > 0) {
+            S2 -= 1; I2 += 1; ell2 += 1;
+            ll += log(lambda)-log(I1*I2);
+          } else {
+            // the genealogy is incompatible with the state.
+            // nevertheless, the state remains valid.
+            I2 += 1; N2 += 1; ell2 += 1;
+            ll += R_NegInf;
+          }
         }
-        ll -= log(0.5);
-        if (S1 > 0) {
-          S1 -= 1; I1 += 1; ell1 += 1;
-          ll += log(lambda)-log(I1*I2);
-        } else {
-          // the genealogy is incompatible with the state.
-          // nevertheless, the state remains valid.
-          I1 += 1; N1 += 1; ell1 += 1;
-          ll += R_NegInf;
+      } else if (parcol == host2) { // parent is in I2
+        assert(S1>=0 && S2 >=0 && I2>=ell2);
+        double lambda12 = Beta12*S1*I2/N2;
+        double lambda22 = Beta22*S2*I2/N2;
+        double lambda = lambda12+lambda22;
+        double x = (lambda > 0) ? lambda22/lambda : 0;
+        int c1 = child[index[parent]];
+        int c2 = child[index[parent]+1];
+        assert(c1 != c2);
+        assert(lineage[c1] != lineage[c2]);
+        assert(lineage[c1] != parlin || lineage[c2] != parlin);
+        assert(lineage[c1] == parlin || lineage[c2] == parlin);
+        if (unif_rand() < x) { // s = (0,2)
+          color[lineage[c1]] = host2;
+          color[lineage[c2]] = host2;
+          if (S2 > 0) {
+            S2 -= 1; I2 += 1; ell2 += 1;
+            ll += log(lambda)-log(I2*(I2-1)/2);
+          } else {
+            // the genealogy is incompatible with the state.
+            // nevertheless, the state remains valid.
+            I2 += 1; N2 += 1; ell2 += 1;
+            ll += R_NegInf;
+          }
+        } else {                // s = (1,1)
+          if (unif_rand() < 0.5) {
+            color[lineage[c1]] = host1;
+            color[lineage[c2]] = host2;
+          } else {
+            color[lineage[c1]] = host2;
+            color[lineage[c2]] = host1;
+          }
+          ll -= log(0.5);
+          if (S1 > 0) {
+            S1 -= 1; I1 += 1; ell1 += 1;
+            ll += log(lambda)-log(I1*I2);
+          } else {
+            // the genealogy is incompatible with the state.
+            // nevertheless, the state remains valid.
+            I1 += 1; N1 += 1; ell1 += 1;
+            ll += R_NegInf;
+          }
         }
+      } else {
+        assert(0);              // #nocov
+        ll += R_NegInf;         // #nocov
       }
-    } else {
-      assert(0);                // #nocov
-      ll += R_NegInf;           // #nocov
+      assert(nearbyint(N1)==nearbyint(S1+I1+R1));
+      assert(nearbyint(N2)==nearbyint(S2+I2+R2));
+      assert(check_color(color,nsample,ell1,ell2));
+      break;
     }
-    assert(nearbyint(N1)==nearbyint(S1+I1+R1));
-    assert(nearbyint(N2)==nearbyint(S2+I2+R2));
-    assert(check_color(color,nsample,ell1,ell2));
-    break;
-  }
+  } while (++parent < nnode && group[parent] == group[parent-1]);
 
   // continuous portion of filter equation:
-  // take Gillespie steps to the end of the interval.
+  // take Gillespie steps to the end of the interval,
+  // or, if tau > 0, tau leaps where these are safe.
   if (tmax > t) {
 
     double rate[nrate], logpi[nrate];
     int event;
     double event_rate = 0;
     double penalty = 0;
+    const double tau = *get_userdata_double("tau");
+    // if guided, the lineage of the next node, if a sample,
+    // and the host in which it must then lie
+    const int guide = *get_userdata_int("guide");
+    int glin = -1, gdeme = 0;
+    if (guide && parent < nnode && nodetype[parent] == 1) {
+      glin = lineage[parent];
+      gdeme = nodedeme[parent];
+    }
+    double glog = 0;
 
     event_rate = EVENT_RATES;
-    tstep = exp_rand()/event_rate;
 
-    while (t + tstep < tmax) {
-      event = rcateg(event_rate,rate,nrate);
+    while (t < tmax) {
+      event = -1;
+      tstep = 0;
+      if (tau > 0) {
+        double h = (tmax - t < tau) ? tmax - t : tau;
+        h = leap_bound(h,S1,rate[8]+rate[10],rate[0]+rate[4]+rate[12]);
+        h = leap_bound(h,I1-ell1,rate[0]+rate[4],rate[6]+rate[13]);
+        h = leap_bound(h,R1,rate[6],rate[8]+rate[14]);
+        h = leap_bound(h,S2,rate[9]+rate[11],rate[1]+rate[2]+rate[15]);
+        h = leap_bound(h,I2-ell2,rate[1]+rate[2],rate[7]+rate[16]);
+        h = leap_bound(h,R2,rate[7],rate[9]+rate[17]);
+        if (event_rate*h >= leap_min) {
+          // events that move lineages are not leapt over:
+          // the leap stops at the first of them.
+          double lrate[nrate];
+          double tl = exp_rand()/masked_rates(rate,lineage_event,lrate,nrate);
+          if (tl < h) h = tl;
+          double x0[9] = {S1, I1, R1, N1, S2, I2, R2, N2, ll};
+          double k[nrate];
+          // rates, and weights of the events, at the expected midpoint
+          for (int e = 0; e < nrate; e++)
+            k[e] = (lineage_event[e]) ? 0 : 0.5*h*rate[e];
+          twospecies_apply(__x,__stateindex,k,1);
+          EVENT_RATES;
+          for (int e = 0; e < nrate; e++)
+            k[e] = (lineage_event[e]) ? 0 : leap_count(rate[e],h);
+          if (k[2] > 0) ll += k[2]*(log(1-ell2/(I2+1))-logpi[2]);
+          if (k[4] > 0) ll += k[4]*(log(1-ell1/(I1+1))-logpi[4]);
+          ll -= penalty*h;
+          S1 = x0[0]; I1 = x0[1]; R1 = x0[2]; N1 = x0[3];
+          S2 = x0[4]; I2 = x0[5]; R2 = x0[6]; N2 = x0[7];
+          twospecies_apply(__x,__stateindex,k,0);
+          if (S1 >= 0 && I1 >= ell1 && R1 >= 0 &&
+              S2 >= 0 && I2 >= ell2 && R2 >= 0) {
+            t = (h < tmax - t) ? t + h : tmax;
+            event_rate = EVENT_RATES;
+            if (h < tl) continue;
+            double lr = masked_rates(rate,lineage_event,lrate,nrate);
+            if (!(lr > 0)) continue;
+            event = rcateg(lr,lrate,nrate);
+          } else {
+            // the leap overshot: take an exact step
+            S1 = x0[0]; I1 = x0[1]; R1 = x0[2]; N1 = x0[3];
+            S2 = x0[4]; I2 = x0[5]; R2 = x0[6]; N2 = x0[7];
+            ll = x0[8];
+            event_rate = EVENT_RATES;
+          }
+        }
+      }
+      if (event < 0) {
+        tstep = exp_rand()/event_rate;
+        if (t + tstep >= tmax) break;
+        event = rcateg(event_rate,rate,nrate);
+      }
       assert(event>=0 && event<nrate);
       ll -= penalty*tstep + logpi[event];
       switch (event) {
@@ -539,6 +661,7 @@ void twospecies_gill
         assert(S2>=1 && I1>=0);
         S2 -= 1; I2 += 1;
         change_color(color,nsample,random_choice(ell1),host1,host2);
+        if (glin >= 0 && nearbyint(color[glin]) == gdeme) ll += glog;
         ell1 -= 1; ell2 += 1;
         ll += log(1-ell1/I1)-log(I2);
         assert(check_color(color,nsample,ell1,ell2));
@@ -554,6 +677,7 @@ void twospecies_gill
         assert(S1>=1 && I2>=0);
         S1 -= 1; I1 += 1;
         change_color(color,nsample,random_choice(ell2),host2,host1);
+        if (glin >= 0 && nearbyint(color[glin]) == gdeme) ll += glog;
         ell2 -= 1; ell1 += 1;
         ll += log(1-ell2/I2)-log(I1);
         assert(check_color(color,nsample,ell1,ell2));
@@ -607,6 +731,22 @@ void twospecies_gill
         assert(R2>=1 && N2>=1);
         R2 -= 1; N2 -= 1;
         break;
+      case 18:                  // 18: guided move of lineage 'glin'
+        color[glin] = gdeme;
+        if (gdeme == host2) {   // as for event 3
+          assert(S2>=1 && I1>=0);
+          S2 -= 1; I2 += 1;
+          ell1 -= 1; ell2 += 1;
+          ll += glog+log(1-ell1/I1)-log(I2);
+        } else {                // as for event 5
+          assert(S1>=1 && I2>=0);
+          S1 -= 1; I1 += 1;
+          ell2 -= 1; ell1 += 1;
+          ll += glog+log(1-ell2/I2)-log(I1);
+        }
+        assert(check_color(color,nsample,ell1,ell2));
+        assert(!ISNAN(ll));
+        break;
       default:                  // #nocov
         assert(0);              // #nocov
         ll += R_NegInf;         // #nocov
@@ -622,13 +762,15 @@ void twospecies_gill
 
       t += tstep;
       event_rate = EVENT_RATES;
-      tstep = exp_rand()/event_rate;
 
     }
     tstep = tmax - t;
     ll -= penalty*tstep;
+    // a lineage left in the other host cannot give rise to the next sample:
+    // the particle is discarded now, rather than after resampling.
+    if (glin >= 0 && nearbyint(color[glin]) != gdeme) ll += R_NegInf;
   }
-  node += 1;
+  node = parent;
 }
 
 # define lik  (__lik[0])
@@ -0,0 +1,151 @@
+// BDEI: Linear birth-death with exposed and infectious classes (filter equation, C++)
+#include "filter.h"
+
+static const int exposed = 1;
+static const int infectious = 2;
+
+//! BDEI process state.
+typedef struct {
+  int E;
+  int I;
+} bdei_state_t;
+
+//! BDEI process parameters.
+typedef struct {
+  double sigma;
+  double lambda;
+  double mu;
+  double chi;
+  double pop;
+  double E0;
+  double I0;
+} bdei_parameters_t;
+
+using bdei_filter_t = filter_t<bdei_state_t,bdei_parameters_t,4,2>;
+
+template<>
+const int bdei_filter_t::nvar = 2;
+
+template<>
+const action_t bdei_filter_t::action[4] = {
+  {migrating,exposed,infectious},
+  {birthing,infectious,exposed},
+  {dying,infectious,0},
+  {culling,infectious,0}
+};
+
+template<>
+void bdei_filter_t::get_params (const double *p, const int *pidx) {
+  int m = 0;
+  PARAM_GET(sigma);
+  PARAM_GET(lambda);
+  PARAM_GET(mu);
+  PARAM_GET(chi);
+  PARAM_GET(pop);
+  PARAM_GET(E0);
+  PARAM_GET(I0);
+}
+
+template<>
+void bdei_filter_t::get_state (const double *x, const int *sidx) {
+  int m = 0;
+  STATE_GET(E);
+  STATE_GET(I);
+}
+
+template<>
+void bdei_filter_t::put_state (double *x, const int *sidx) const {
+  int m = 0;
+  STATE_PUT(E);
+  STATE_PUT(I);
+}
+
+template<>
+void bdei_filter_t::rinit (void) {
+  double m = params.pop/(params.E0 + params.I0);
+  state.E = nearbyint(m*params.E0);
+  state.I = nearbyint(m*params.I0);
+  graft(exposed, state.E);
+  graft(infectious, state.I);
+}
+
+template<>
+double bdei_filter_t::event_rates (double *rate, int n) const {
+  int m = 0;
+  double total = 0;
+  RATE_CALC(params.sigma * state.E);
+  RATE_CALC(params.lambda * state.I);
+  RATE_CALC(params.mu * state.I);
+  RATE_CALC(params.chi * state.I);
+  if (m != n) err("wrong number of events!");
+  return total;
+}
+
+template<>
+void bdei_filter_t::jump (int event) {
+  switch (event) {
+  case 0:
+    state.E -= 1; state.I += 1; migrate(exposed, infectious);
+    break;
+  case 1:
+    state.E += 1; birth(infectious, exposed);
+    break;
+  case 2:
+    state.I -= 1; death(infectious);
+    break;
+  case 3:
+    state.I -= 1; sample_death(infectious);
+    break;
+  default:                      // #nocov
+    assert(0);                  // #nocov
+    break;                      // #nocov
+  }
+}
+
+template<>
+double bdei_filter_t::size (int d) const {
+  switch (d) {
+  case exposed:
+    return state.E;
+  case infectious:
+    return state.I;
+  default:
+    return -1;
+  }
+}
+
+extern "C" {
+
+//! Latent-state initializer (rinit component).
+void bdei_rinit
+(
+ double *x, const double *p, double t0,
+ const int *stateindex, const int *parindex,
+ const int *covindex, const double *covars
+ ) {
+  bdei_filter_t::pomp_rinit(x,p,stateindex,parindex);
+}
+
+//! Simulator for the latent-state process (rprocess component).
+void bdei_gill
+(
+ double *x, const double *p,
+ const int *stateindex, const int *parindex,
+ const int *covindex, const double *covars,
+ double t, double dt
+ ) {
+  bdei_filter_t::pomp_step(x,p,stateindex,parindex,t,dt);
+}
+
+//! Measurement model likelihood (dmeasure component).
+void bdei_dmeas
+(
+ double *lik, const double *y, const double *x, const double *p,
+ int give_log, const int *obsindex,
+ const int *stateindex, const int *parindex,
+ const int *covindex, const double *covars, double t
+ ) {
+  bdei_filter_t::pomp_dmeas(lik,x,stateindex,give_log);
+}
+
+}
@@ -0,0 +1,175 @@
+// BDSS: Linear birth-death with superspreading (filter equation, C++)
+#include "filter.h"
+
+static const int normal = 1;
+static const int superspreader = 2;
+
+//! BDSS process state.
+typedef struct {
+  int N;
+  int S;
+} bdss_state_t;
+
+//! BDSS process parameters.
+typedef struct {
+  double lambda_nn;
+  double lambda_ns;
+  double lambda_sn;
+  double lambda_ss;
+  double mu;
+  double chi;
+  double pop;
+  double N0;
+  double S0;
+} bdss_parameters_t;
+
+using bdss_filter_t = filter_t<bdss_state_t,bdss_parameters_t,8,2>;
+
+template<>
+const int bdss_filter_t::nvar = 2;
+
+template<>
+const action_t bdss_filter_t::action[8] = {
+  {birthing,normal,normal},
+  {birthing,normal,superspreader},
+  {birthing,superspreader,normal},
+  {birthing,superspreader,superspreader},
+  {dying,normal,0},
+  {dying,superspreader,0},
+  {culling,normal,0},
+  {culling,superspreader,0}
+};
+
+template<>
+void bdss_filter_t::get_params (const double *p, const int *pidx) {
+  int m = 0;
+  PARAM_GET(lambda_nn);
+  PARAM_GET(lambda_ns);
+  PARAM_GET(lambda_sn);
+  PARAM_GET(lambda_ss);
+  PARAM_GET(mu);
+  PARAM_GET(chi);
+  PARAM_GET(pop);
+  PARAM_GET(N0);
+  PARAM_GET(S0);
+}
+
+template<>
+void bdss_filter_t::get_state (const double *x, const int *sidx) {
+  int m = 0;
+  STATE_GET(N);
+  STATE_GET(S);
+}
+
+template<>
+void bdss_filter_t::put_state (double *x, const int *sidx) const {
+  int m = 0;
+  STATE_PUT(N);
+  STATE_PUT(S);
+}
+
+template<>
+void bdss_filter_t::rinit (void) {
+  double m = params.pop/(params.N0 + params.S0);
+  state.N = nearbyint(m*params.N0);
+  state.S = nearbyint(m*params.S0);
+  graft(normal, state.N);
+  graft(superspreader, state.S);
+}
+
+template<>
+double bdss_filter_t::event_rates (double *rate, int n) const {
+  int m = 0;
+  double total = 0;
+  RATE_CALC(params.lambda_nn * state.N);
+  RATE_CALC(params.lambda_ns * state.N);
+  RATE_CALC(params.lambda_sn * state.S);
+  RATE_CALC(params.lambda_ss * state.S);
+  RATE_CALC(params.mu * state.N);
+  RATE_CALC(params.mu * state.S);
+  RATE_CALC(params.chi * state.N);
+  RATE_CALC(params.chi * state.S);
+  if (m != n) err("wrong number of events!");
+  return total;
+}
+
+template<>
+void bdss_filter_t::jump (int event) {
+  switch (event) {
+  case 0:
+    state.N += 1; birth(normal, normal);
+    break;
+  case 1:
+    state.S += 1; birth(normal, superspreader);
+    break;
+  case 2:
+    state.N += 1; birth(superspreader, normal);
+    break;
+  case 3:
+    state.S += 1; birth(superspreader, superspreader);
+    break;
+  case 4:
+    state.N -= 1; death(normal);
+    break;
+  case 5:
+    state.S -= 1; death(superspreader);
+    break;
+  case 6:
+    state.N -= 1; sample_death(normal);
+    break;
+  case 7:
+    state.S -= 1; sample_death(superspreader);
+    break;
+  default:                      // #nocov
+    assert(0);                  // #nocov
+    break;                      // #nocov
+  }
+}
+
+template<>
+double bdss_filter_t::size (int d) const {
+  switch (d) {
+  case normal:
+    return state.N;
+  case superspreader:
+    return state.S;
+  default:
+    return -1;
+  }
+}
+
+extern "C" {
+
+//! Latent-state initializer (rinit component).
+void bdss_rinit
+(
+ double *x, const double *p, double t0,
+ const int *stateindex, const int *parindex,
+ const int *covindex, const double *covars
+ ) {
+  bdss_filter_t::pomp_rinit(x,p,stateindex,parindex);
+}
+
+//! Simulator for the latent-state process (rprocess component).
+void bdss_gill
+(
+ double *x, const double *p,
+ const int *stateindex, const int *parindex,
+ const int *covindex, const double *covars,
+ double t, double dt
+ ) {
+  bdss_filter_t::pomp_step(x,p,stateindex,parindex,t,dt);
+}
+
+//! Measurement model likelihood (dmeasure component).
+void bdss_dmeas
+(
+ double *lik, const double *y, const double *x, const double *p,
+ int give_log, const int *obsindex,
+ const int *stateindex, const int *parindex,
+ const int *covindex, const double *covars, double t
+ ) {
+  bdss_filter_t::pomp_dmeas(lik,x,stateindex,give_log);
+}
+
+}
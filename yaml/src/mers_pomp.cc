@@ -0,0 +1,218 @@
+// MERS: Two-host infection model with spillover and demography. Hosts are culled upon sampling. (filter equation, C++)
+#include "filter.h"
+
+static const int camel = 1;
+static const int human = 2;
+
+//! MERS process state.
+typedef struct {
+  int Sc;
+  int Ic;
+  int Sh;
+  int Ih;
+} mers_state_t;
+
+//! MERS process parameters.
+typedef struct {
+  double Beta_cc;
+  double Beta_ch;
+  double Beta_hc;
+  double Beta_hh;
+  double gamma_c;
+  double gamma_h;
+  double chi_c;
+  double chi_h;
+  double Bc;
+  double Bh;
+  double Sc0;
+  double Sh0;
+  double Ic0;
+  double Ih0;
+  double Nc;
+  double Nh;
+} mers_parameters_t;
+
+using mers_filter_t = filter_t<mers_state_t,mers_parameters_t,12,2>;
+
+template<>
+const int mers_filter_t::nvar = 4;
+
+template<>
+const action_t mers_filter_t::action[12] = {
+  {birthing,camel,camel},
+  {birthing,human,human},
+  {birthing,human,camel},
+  {birthing,camel,human},
+  {dying,camel,0},
+  {dying,human,0},
+  {culling,camel,0},
+  {culling,human,0},
+  {nothing,0,0},
+  {nothing,0,0},
+  {nothing,0,0},
+  {nothing,0,0}
+};
+
+template<>
+void mers_filter_t::get_params (const double *p, const int *pidx) {
+  int m = 0;
+  PARAM_GET(Beta_cc);
+  PARAM_GET(Beta_ch);
+  PARAM_GET(Beta_hc);
+  PARAM_GET(Beta_hh);
+  PARAM_GET(gamma_c);
+  PARAM_GET(gamma_h);
+  PARAM_GET(chi_c);
+  PARAM_GET(chi_h);
+  PARAM_GET(Bc);
+  PARAM_GET(Bh);
+  PARAM_GET(Sc0);
+  PARAM_GET(Sh0);
+  PARAM_GET(Ic0);
+  PARAM_GET(Ih0);
+  PARAM_GET(Nc);
+  PARAM_GET(Nh);
+}
+
+template<>
+void mers_filter_t::get_state (const double *x, const int *sidx) {
+  int m = 0;
+  STATE_GET(Sc);
+  STATE_GET(Ic);
+  STATE_GET(Sh);
+  STATE_GET(Ih);
+}
+
+template<>
+void mers_filter_t::put_state (double *x, const int *sidx) const {
+  int m = 0;
+  STATE_PUT(Sc);
+  STATE_PUT(Ic);
+  STATE_PUT(Sh);
+  STATE_PUT(Ih);
+}
+
+template<>
+void mers_filter_t::rinit (void) {
+  double fc = params.Nc/(params.Sc0+params.Ic0);
+  double fh = params.Nh/(params.Sh0+params.Ih0);
+  state.Sc = nearbyint(fc*params.Sc0);
+  state.Ic = nearbyint(fc*params.Ic0);
+  state.Sh = nearbyint(fh*params.Sh0);
+  state.Ih = nearbyint(fh*params.Ih0);
+  graft(camel,state.Ic);
+  graft(human,state.Ih);
+}
+
+template<>
+double mers_filter_t::event_rates (double *rate, int n) const {
+  int m = 0;
+  double total = 0;
+  RATE_CALC(params.Beta_cc * state.Sc * state.Ic / params.Nc);
+  RATE_CALC(params.Beta_hh * state.Sh * state.Ih / params.Nh);
+  RATE_CALC(params.Beta_ch * state.Sc * state.Ih / params.Nh);
+  RATE_CALC(params.Beta_hc * state.Sh * state.Ic / params.Nc);
+  RATE_CALC(params.gamma_c * state.Ic);
+  RATE_CALC(params.gamma_h * state.Ih);
+  RATE_CALC(params.chi_c * state.Ic);
+  RATE_CALC(params.chi_h * state.Ih);
+  RATE_CALC(params.Bc);
+  RATE_CALC(params.Bh);
+  RATE_CALC(params.Bc/params.Nc * state.Sc);
+  RATE_CALC(params.Bh/params.Nh * state.Sh);
+  if (m != n) err("wrong number of events!");
+  return total;
+}
+
+template<>
+void mers_filter_t::jump (int event) {
+  switch (event) {
+  case 0:
+    state.Sc -= 1; state.Ic += 1; birth(camel,camel);
+    break;
+  case 1:
+    state.Sh -= 1; state.Ih += 1; birth(human,human);
+    break;
+  case 2:
+    state.Sc -= 1; state.Ic += 1; birth(human,camel);
+    break;
+  case 3:
+    state.Sh -= 1; state.Ih += 1; birth(camel,human);
+    break;
+  case 4:
+    state.Ic -= 1; death(camel);
+    break;
+  case 5:
+    state.Ih -= 1; death(human);
+    break;
+  case 6:
+    state.Ic -= 1; sample_death(camel);
+    break;
+  case 7:
+    state.Ih -= 1; sample_death(human);
+    break;
+  case 8:
+    state.Sc += 1;
+    break;
+  case 9:
+    state.Sh += 1;
+    break;
+  case 10:
+    state.Sc -= 1;
+    break;
+  case 11:
+    state.Sh -= 1;
+    break;
+  default:                      // #nocov
+    assert(0);                  // #nocov
+    break;                      // #nocov
+  }
+}
+
+template<>
+double mers_filter_t::size (int d) const {
+  switch (d) {
+  case camel:
+    return state.Ic;
+  case human:
+    return state.Ih;
+  default:
+    return -1;
+  }
+}
+
+extern "C" {
+
+//! Latent-state initializer (rinit component).
+void mers_rinit
+(
+ double *x, const double *p, double t0,
+ const int *stateindex, const int *parindex,
+ const int *covindex, const double *covars
+ ) {
+  mers_filter_t::pomp_rinit(x,p,stateindex,parindex);
+}
+
+//! Simulator for the latent-state process (rprocess component).
+void mers_gill
+(
+ double *x, const double *p,
+ const int *stateindex, const int *parindex,
+ const int *covindex, const double *covars,
+ double t, double dt
+ ) {
+  mers_filter_t::pomp_step(x,p,stateindex,parindex,t,dt);
+}
+
+//! Measurement model likelihood (dmeasure component).
+void mers_dmeas
+(
+ double *lik, const double *y, const double *x, const double *p,
+ int give_log, const int *obsindex,
+ const int *stateindex, const int *parindex,
+ const int *covindex, const double *covars, double t
+ ) {
+  mers_filter_t::pomp_dmeas(lik,x,stateindex,give_log);
+}
+
+}
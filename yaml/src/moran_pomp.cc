@@ -0,0 +1,127 @@
+// Moran: The classical Moran model (filter equation, C++)
+#include "filter.h"
+
+static const int deme = 1;
+
+//! Moran process state.
+typedef struct {
+  int m;
+  int g;
+} moran_state_t;
+
+//! Moran process parameters.
+typedef struct {
+  double mu;
+  double psi;
+  int n;
+} moran_parameters_t;
+
+using moran_filter_t = filter_t<moran_state_t,moran_parameters_t,2,1>;
+
+template<>
+const int moran_filter_t::nvar = 2;
+
+template<>
+const action_t moran_filter_t::action[2] = {
+  {birthing,deme,deme},
+  {sampling,deme,0}
+};
+
+template<>
+void moran_filter_t::get_params (const double *p, const int *pidx) {
+  int m = 0;
+  PARAM_GET(mu);
+  PARAM_GET(psi);
+  PARAM_GET(n);
+}
+
+template<>
+void moran_filter_t::get_state (const double *x, const int *sidx) {
+  int m = 0;
+  STATE_GET(m);
+  STATE_GET(g);
+}
+
+template<>
+void moran_filter_t::put_state (double *x, const int *sidx) const {
+  int m = 0;
+  STATE_PUT(m);
+  STATE_PUT(g);
+}
+
+template<>
+void moran_filter_t::rinit (void) {
+  state.m = state.g = 0;
+  graft(deme,params.n);
+}
+
+template<>
+double moran_filter_t::event_rates (double *rate, int n) const {
+  int m = 0;
+  double total = 0;
+  RATE_CALC(params.mu * params.n);
+  RATE_CALC(params.psi * params.n);
+  if (m != n) err("wrong number of events!");
+  return total;
+}
+
+template<>
+void moran_filter_t::jump (int event) {
+  switch (event) {
+  case 0:
+    state.m += 1; birth(); death();
+    break;
+  case 1:
+    state.g += 1; sample();
+    break;
+  default:                      // #nocov
+    assert(0);                  // #nocov
+    break;                      // #nocov
+  }
+}
+
+template<>
+double moran_filter_t::size (int d) const {
+  switch (d) {
+  case deme:
+    return params.n;
+  default:
+    return -1;
+  }
+}
+
+extern "C" {
+
+//! Latent-state initializer (rinit component).
+void moran_rinit
+(
+ double *x, const double *p, double t0,
+ const int *stateindex, const int *parindex,
+ const int *covindex, const double *covars
+ ) {
+  moran_filter_t::pomp_rinit(x,p,stateindex,parindex);
+}
+
+//! Simulator for the latent-state process (rprocess component).
+void moran_gill
+(
+ double *x, const double *p,
+ const int *stateindex, const int *parindex,
+ const int *covindex, const double *covars,
+ double t, double dt
+ ) {
+  moran_filter_t::pomp_step(x,p,stateindex,parindex,t,dt);
+}
+
+//! Measurement model likelihood (dmeasure component).
+void moran_dmeas
+(
+ double *lik, const double *y, const double *x, const double *p,
+ int give_log, const int *obsindex,
+ const int *stateindex, const int *parindex,
+ const int *covindex, const double *covars, double t
+ ) {
+  moran_filter_t::pomp_dmeas(lik,x,stateindex,give_log);
+}
+
+}
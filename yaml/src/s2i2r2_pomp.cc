@@ -0,0 +1,278 @@
+// S2I2R2: Two-host infection model with waning, immigration, and demography. (filter equation, C++)
+#include "filter.h"
+
+static const int host1 = 1;
+static const int host2 = 2;
+static const int outside = 3;
+
+//! S2I2R2 process state.
+typedef struct {
+  int S1;
+  int I1;
+  int R1;
+  int S2;
+  int I2;
+  int R2;
+  double N1;
+  double N2;
+} s2i2r2_state_t;
+
+//! S2I2R2 process parameters.
+typedef struct {
+  double Beta11;
+  double Beta12;
+  double Beta22;
+  double gamma1;
+  double gamma2;
+  double psi1;
+  double psi2;
+  double omega1;
+  double omega2;
+  double b1;
+  double b2;
+  double d1;
+  double d2;
+  double iota1;
+  double iota2;
+  int S1_0;
+  int S2_0;
+  int I1_0;
+  int I2_0;
+  int R1_0;
+  int R2_0;
+} s2i2r2_parameters_t;
+
+using s2i2r2_filter_t = filter_t<s2i2r2_state_t,s2i2r2_parameters_t,19,3>;
+
+template<>
+const int s2i2r2_filter_t::nvar = 8;
+
+template<>
+const action_t s2i2r2_filter_t::action[19] = {
+  {birthing,host1,host1},
+  {birthing,host2,host2},
+  {birthing,host2,host1},
+  {dying,host1,0},
+  {dying,host2,0},
+  {nothing,0,0},
+  {nothing,0,0},
+  {sampling,host1,0},
+  {sampling,host2,0},
+  {importing,outside,host1},
+  {importing,outside,host2},
+  {nothing,0,0},
+  {nothing,0,0},
+  {dying,host1,0},
+  {dying,host2,0},
+  {nothing,0,0},
+  {nothing,0,0},
+  {nothing,0,0},
+  {nothing,0,0}
+};
+
+template<>
+void s2i2r2_filter_t::get_params (const double *p, const int *pidx) {
+  int m = 0;
+  PARAM_GET(Beta11);
+  PARAM_GET(Beta12);
+  PARAM_GET(Beta22);
+  PARAM_GET(gamma1);
+  PARAM_GET(gamma2);
+  PARAM_GET(psi1);
+  PARAM_GET(psi2);
+  PARAM_GET(omega1);
+  PARAM_GET(omega2);
+  PARAM_GET(b1);
+  PARAM_GET(b2);
+  PARAM_GET(d1);
+  PARAM_GET(d2);
+  PARAM_GET(iota1);
+  PARAM_GET(iota2);
+  PARAM_GET(S1_0);
+  PARAM_GET(S2_0);
+  PARAM_GET(I1_0);
+  PARAM_GET(I2_0);
+  PARAM_GET(R1_0);
+  PARAM_GET(R2_0);
+}
+
+template<>
+void s2i2r2_filter_t::get_state (const double *x, const int *sidx) {
+  int m = 0;
+  STATE_GET(S1);
+  STATE_GET(I1);
+  STATE_GET(R1);
+  STATE_GET(S2);
+  STATE_GET(I2);
+  STATE_GET(R2);
+  STATE_GET(N1);
+  STATE_GET(N2);
+}
+
+template<>
+void s2i2r2_filter_t::put_state (double *x, const int *sidx) const {
+  int m = 0;
+  STATE_PUT(S1);
+  STATE_PUT(I1);
+  STATE_PUT(R1);
+  STATE_PUT(S2);
+  STATE_PUT(I2);
+  STATE_PUT(R2);
+  STATE_PUT(N1);
+  STATE_PUT(N2);
+}
+
+template<>
+void s2i2r2_filter_t::rinit (void) {
+  state.S1 = params.S1_0;
+  state.I1 = params.I1_0;
+  state.R1 = params.R1_0;
+  state.S2 = params.S2_0;
+  state.I2 = params.I2_0;
+  state.R2 = params.R2_0;
+  state.N1 = double(params.S1_0+params.I1_0+params.R1_0);
+  state.N2 = double(params.S2_0+params.I2_0+params.R2_0);
+  graft(host1,params.I1_0);
+  graft(host2,params.I2_0);
+}
+
+template<>
+double s2i2r2_filter_t::event_rates (double *rate, int n) const {
+  int m = 0;
+  double total = 0;
+  RATE_CALC(params.Beta11 * state.I1 / state.N1 * state.S1);
+  RATE_CALC(params.Beta22 * state.I2 / state.N2 * state.S2);
+  RATE_CALC(params.Beta12 * state.I2 / state.N2 * state.S1);
+  RATE_CALC(params.gamma1 * state.I1);
+  RATE_CALC(params.gamma2 * state.I2);
+  RATE_CALC(params.omega1 * state.R1);
+  RATE_CALC(params.omega2 * state.R2);
+  RATE_CALC(params.psi1 * state.I1);
+  RATE_CALC(params.psi2 * state.I2);
+  RATE_CALC(params.iota1 * state.S1);
+  RATE_CALC(params.iota2 * state.S2);
+  RATE_CALC(params.d1 * state.S1);
+  RATE_CALC(params.d2 * state.S2);
+  RATE_CALC(params.d1 * state.I1);
+  RATE_CALC(params.d2 * state.I2);
+  RATE_CALC(params.d1 * state.R1);
+  RATE_CALC(params.d2 * state.R2);
+  RATE_CALC(params.b1 * state.N1);
+  RATE_CALC(params.b2 * state.N2);
+  if (m != n) err("wrong number of events!");
+  return total;
+}
+
+template<>
+void s2i2r2_filter_t::jump (int event) {
+  switch (event) {
+  case 0:
+    state.S1 -= 1; state.I1 += 1; birth(host1,host1);
+    break;
+  case 1:
+    state.S2 -= 1; state.I2 += 1; birth(host2,host2);
+    break;
+  case 2:
+    state.S1 -= 1; state.I1 += 1; birth(host2,host1);
+    break;
+  case 3:
+    state.I1 -= 1; state.R1 += 1; death(host1);
+    break;
+  case 4:
+    state.I2 -= 1; state.R2 += 1; death(host2);
+    break;
+  case 5:
+    state.R1 -= 1; state.S1 += 1;
+    break;
+  case 6:
+    state.R2 -= 1; state.S2 += 1;
+    break;
+  case 7:
+    sample(host1);
+    break;
+  case 8:
+    sample(host2);
+    break;
+  case 9:
+    state.S1 -= 1; state.I1 += 1; graft(outside); migrate(outside,host1);
+    break;
+  case 10:
+    state.S2 -= 1; state.I2 += 1; graft(outside); migrate(outside,host2);
+    break;
+  case 11:
+    state.S1 -= 1; state.N1 -= 1;
+    break;
+  case 12:
+    state.S2 -= 1; state.N2 -= 1;
+    break;
+  case 13:
+    state.I1 -= 1; state.N1 -= 1; death(host1);
+    break;
+  case 14:
+    state.I2 -= 1; state.N2 -= 1; death(host2);
+    break;
+  case 15:
+    state.R1 -= 1; state.N1 -= 1;
+    break;
+  case 16:
+    state.R2 -= 1; state.N2 -= 1;
+    break;
+  case 17:
+    state.S1 += 1; state.N1 += 1;
+    break;
+  case 18:
+    state.S2 += 1; state.N2 += 1;
+    break;
+  default:                      // #nocov
+    assert(0);                  // #nocov
+    break;                      // #nocov
+  }
+}
+
+template<>
+double s2i2r2_filter_t::size (int d) const {
+  switch (d) {
+  case host1:
+    return state.I1;
+  case host2:
+    return state.I2;
+  default:
+    return -1;
+  }
+}
+
+extern "C" {
+
+//! Latent-state initializer (rinit component).
+void s2i2r2_rinit
+(
+ double *x, const double *p, double t0,
+ const int *stateindex, const int *parindex,
+ const int *covindex, const double *covars
+ ) {
+  s2i2r2_filter_t::pomp_rinit(x,p,stateindex,parindex);
+}
+
+//! Simulator for the latent-state process (rprocess component).
+void s2i2r2_gill
+(
+ double *x, const double *p,
+ const int *stateindex, const int *parindex,
+ const int *covindex, const double *covars,
+ double t, double dt
+ ) {
+  s2i2r2_filter_t::pomp_step(x,p,stateindex,parindex,t,dt);
+}
+
+//! Measurement model likelihood (dmeasure component).
+void s2i2r2_dmeas
+(
+ double *lik, const double *y, const double *x, const double *p,
+ int give_log, const int *obsindex,
+ const int *stateindex, const int *parindex,
+ const int *covindex, const double *covars, double t
+ ) {
+  s2i2r2_filter_t::pomp_dmeas(lik,x,stateindex,give_log);
+}
+
+}